@@ -5,76 +5,395 @@
 
 #include "App_HRFunc.h"
 #include "CMUtil.h"
-#include "Dev_ADS1x9x.h"
-#include "QRSDET.h"
+#include "Dev_ADS1x9x.H"
+#include "QRSDET.H"
 #include "Service_HRMonitor.h"
-#include "service_ecg.h"
-#include "cmtechhrmonitor.h"
+#include "Service_Ecg.h"
+#include "CMTechHRMonitor.h"
+#include "EcgCodec.h"
+#include "Hrv.h"
+#include "Sqi.h"
+#include "Bpm.h"
+#if defined(ECG_RESP)
+#include "Resp.h"
+#endif
+#if defined(ECG_TPL)
+#include "BeatTpl.h"
+#endif
+#if defined(ENERGY_PROFILE)
+#include "Energy.h"
+#endif
+#if defined(ECG_LOG)
+#include "EcgLog.h"
+#include "Service_EcgLog.h"
+#endif
 
 
-#define ECG_PACK_BYTE_NUM 19 // byte number per ecg packet, 1+9*2
+// byte number per ecg packet, 1 sequence byte + as many samples as the ATT MTU holds
+// that is 1+9*2 with the default 23 bytes MTU
+#define ECG_PACK_BYTE_NUM (1 + ((ATT_MTU_SIZE-3-1)/2)*2)
+#define ECG_PACK_MAX_LEN (ATT_MTU_SIZE-3) // max ecg packet length, the Rice coded packets fill it up
+#define ECG_PACK_QUEUE_LEN 4 // the number of ecg packets waiting for the stack buffers, must be a power of 2
+#define ECG_PACK_QUEUE_MASK (ECG_PACK_QUEUE_LEN-1)
+#define ECG_NOTI_RETRY_PERIOD 10 // ms, retry period when the stack has no buffer for a notification
 #define ECG_MAX_PACK_NUM 255 // max packet num
-#define RRBUF_LEN 9 // the length of rrbuf
+#ifndef ECG_24BIT_EXTRA_BITS
+#define ECG_24BIT_EXTRA_BITS 2 // bits below the 16 bits LSB kept in the ecg samples with a 24 bits chip
+#endif
+#define ECG_DC_FRAC_BITS 4 // fraction bits of the DC removal filter state
+#define ECG_DC_SHIFT 10 // DC removal filter pole is 1-2^-ECG_DC_SHIFT, about 0.04Hz at 250Hz
+#define LOFF_OFF_NUM 64 // consecutive lead-off samples before the contact is lost
+#define LOFF_ON_NUM 32 // consecutive lead-on samples before the contact is found again
+#define LOFF_PROBE_NUM LOFF_ON_NUM // samples checked in one probe while the leads are off
+#define LOFF_POLL_PERIOD 4000 // ms, the leads are probed with this period while they are off
+#define RESP_RING_LEN 4 // the length of the respiration ring buffer, must be a power of 2
+#define RESP_RING_MASK (RESP_RING_LEN-1)
+#ifndef SQI_ECG_MIN
+#define SQI_ECG_MIN 20 // the ecg is not sent while the window signal quality index is lower, 0 always sends it
+#endif
+#ifndef HR_MEDIAN_LEN
+#define HR_MEDIAN_LEN 9 // the number of the last RR intervals whose median gives the bpm
+#endif
+#if (ECG_MODE_SAMPLERATE != BPM_RATE) || (2*HR_MODE_SAMPLERATE != BPM_RATE)
+#error "the bpm table of Bpm.c works at BPM_RATE/2^k"
+#endif
+#define RR_QUEUE_LEN 32 // the length of the RR interval queue, must be a power of 2 and less than 256
+#define RR_QUEUE_MASK (RR_QUEUE_LEN-1)
+#define HR_PACK_RR_NUM ((HRM_MEAS_MAX-2)/2) // max RR intervals per HR packet, after the flags and the bpm
+#define ECG_RING_LEN 32 // the length of the sample ring buffer, must be a power of 2 and less than 256
+#define ECG_RING_MASK (ECG_RING_LEN-1)
+#define ECG_BATCH_LEN 8 // the number of buffered samples that triggers a processing batch
+#define ECG_LOG_RR_NUM 8 // the number of RR intervals in a log record
+
+// ADS1x9x control states, the control steps from one to the next on the OSAL timer
+#define ADS_STATE_OFF       0 // powered down
+#define ADS_STATE_UP        1 // reset and registers set, waiting to enter standby
+#define ADS_STATE_STANDBY   2 // in standby
+#define ADS_STATE_AWAKE     3 // woken up, waiting to start converting
+#define ADS_STATE_SETTLING  4 // converting, the samples are discarded until settled
+#define ADS_STATE_SAMPLING  5 // converting, the samples are processed
+#define ADS_STATE_DOWN      6 // powered down, waiting before it can be powered up again
 
 static uint8 taskId; // taskId of application
 
+// ADS1x9x control state
+static uint8 adsState = ADS_STATE_OFF;
+// is a control step waiting on the timer
+static bool adsWaiting = false;
+// should the ADS1x9x be powered
+static bool adsPower = false;
+// should the ADS1x9x be sampling
+static bool adsSampling = false;
+// should the ADS1x9x registers be set again, e.g. for a new sample rate
+static bool adsReconfig = false;
+// has SAMPLERATE changed, the detector is restarted when the ADS1x9x samples at the new rate
+static bool rateChanged = false;
+// is the sampling suspended because the leads are off
+static bool loffSuspend = false;
+
+// is the skin contact detected
+static bool ecgContact = true;
+// the contact reported in the last HR packet
+static bool contactSent = true;
+// consecutive samples with the leads off when in contact, or with the leads on when not
+static uint8 loffNum = 0;
+// samples checked in the current probe
+static uint8 probeNum = 0;
+
 // is the heart rate calculated?
 static bool hrCalc = false;
+// QRS detector state
+static QRSDetState qrsDet;
 // the flag of the initial beat
 static uint8 initBeat = 1 ;
-// RR interval buffer, the max number in the buffer is 9
-static uint16 rrBuf[RRBUF_LEN] = {0};
-// the current number in rrBuf
+// the last RR intervals in samples, in the order they come
+static uint16 rrWin[HR_MEDIAN_LEN];
+// the same RR intervals in up-order
+static uint16 rrSort[HR_MEDIAN_LEN];
+// the number of RR intervals in the window, and the position of the next one
 static uint8 rrNum = 0;
+static uint8 rrPos = 0;
+// the bpm of the median RR interval, updated per beat
+static uint8 curBPM = 0;
+// RR intervals not notified yet, in 1/1024 second as the Heart Rate Service requires
+static uint16 rrQueue[RR_QUEUE_LEN];
+static uint8 rrQHead = 0;
+static uint8 rrQTail = 0;
 // HR notification struct
 static attHandleValueNoti_t hrNoti;
+// heart rate variability of the RR intervals
+static HrvState_t hrv;
+// signal quality of the detector input
+static SqiState_t sqi;
+// is the signal quality good enough to send the ecg, it is known only when the heart rate is calculated
+static bool sqiGood = true;
+#if defined(ECG_TPL)
+// averaged template of the good beats
+static BeatTpl_t beatTpl;
+// is the template being sent, and the next packet of it
+static bool tplSending = false;
+static uint8 tplPackNum = 0;
+// beat template notification
+static attHandleValueNoti_t tplNoti;
+#endif
+
+// sample ring buffer, filled by the DRDY ISR and drained by the HRM task
+// there is one producer and one consumer, and each index is a single byte
+// written by only one side, so no lock is needed
+static int32 ecgRing[ECG_RING_LEN];
+// the channel 1 lead-off bits of the samples in the ring
+static uint8 ecgLoff[ECG_RING_LEN];
+// free running write index, written only by the ISR
+static volatile uint8 ringHead = 0;
+// free running read index, written only by the task
+static volatile uint8 ringTail = 0;
+// the number of samples dropped because the ring was full, written only by the ISR
+static volatile uint8 ringDropped = 0;
+// the value of ringDropped when the task last looked at it
+static uint8 ringDroppedSeen = 0;
+
+// is the ADS1x9x a 24 bits chip, it is known when powered up
+static bool ecgRes24 = false;
+// DC removal filter of the 24 bits samples
+static int32 dcLast;
+static int32 dcAcc;
+static bool dcInit = true;
+
+#if defined(ECG_RESP)
+// is the respiration measured on channel 2, it is known when powered up
+static bool respOn = false;
+// the respiration is decimated to RESP_RATE by summing respDecim samples in the DRDY ISR
+static uint8 respDecim = HR_MODE_SAMPLERATE/RESP_RATE;
+static int32 respAcc = 0;
+static uint8 respCnt = 0;
+// decimated respiration ring buffer, filled by the DRDY ISR and drained by the HRM task like the sample ring
+static int32 respRing[RESP_RING_LEN];
+static volatile uint8 respHead = 0;
+static volatile uint8 respTail = 0;
+// breathing rate estimator
+static RespState_t resp;
+#endif
 
-// is the ecg data processed
-static bool ecgProcess = false;
 // is the ecg data sent?
 static bool ecgSend = false;
 // the number of the current ecg data packet, from 0 to ECG_MAX_PACK_NUM
 static uint8 pckNum = 0;
-// ecg packet buffer
-static uint8 ecgBuff[ECG_PACK_BYTE_NUM] = {0};
+// ecg packet queue, the packets are filled in by the task and sent out as the stack accepts them
+static uint8 ecgBuff[ECG_PACK_QUEUE_LEN][ECG_PACK_MAX_LEN] = {0};
+// the length of each packet in the queue
+static uint8 packLen[ECG_PACK_QUEUE_LEN] = {0};
+// free running index of the packet being filled in
+static uint8 packHead = 0;
+// free running index of the oldest packet not sent
+static uint8 packTail = 0;
+// the number of packets dropped because the queue was full
+static uint16 packDropped = 0;
+// the ecg packet load counted since it was got last
+static HRFunc_EcgLoad_t packLoad;
 // pointer to the ecg buff
 static uint8* pEcgBuff;
 // ecg packet structure sent out
 static attHandleValueNoti_t ecgNoti;
+// ecg packet format, ECG_PACK_FORMAT_RAW or ECG_PACK_FORMAT_RICE
+static uint8 packFormat = ECG_PACK_FORMAT_RAW;
+// Rice coder of the ecg packets
+static EcgRice_t rice;
+
+#if defined(ECG_LOG)
+// is the ecg and RR logged in the flash?
+static bool ecgLog = false;
+// log record being filled in
+static uint8 logRec[ECG_LOG_REC_LEN];
+// Rice coder of the logged ecg, coding into logRec
+static EcgRice_t logRice;
+// the number of the current logged ecg packet
+static uint8 logPckNum = 0;
+// RR intervals not logged yet
+static uint16 logRr[ECG_LOG_RR_NUM];
+// the number in logRr
+static uint8 logRrNum = 0;
+// is the log being downloaded?
+static bool logDownload = false;
+// is the record in logNoti waiting for the stack buffers
+static bool logPending = false;
+// log record notification
+static attHandleValueNoti_t logNoti;
+#endif
 
-static void processEcgSignal(int16 x);
+static void requestAdsCtrl(void);
+static void setEcgResolution(bool res24); // set the ecg sample scale for the chip
+static void pushEcgSignal(int32 x, int32 r, uint8 loffStat);
+#if defined(ECG_RESP)
+static void pushRespSignal(int32 r); // called in the DRDY ISR: decimate the respiration
+#endif
+static int16 scaleEcgSignal(int32 x); // scale a sample of 24 bits full scale to an ecg sample
+static void processEcgSignal(int32 x, uint8 loff);
+static bool checkContact(uint8 loff); // check the leads with a sample, false if there is no contact
+static void suspendSampling(void); // suspend the sampling until the next probe
 static void saveEcgSignal(int16 ecg);
-static uint16 median(uint16 *array, uint8 datnum);
-//static void processTestSignal(int16 x);
+static void saveEcgSignalRice(int16 ecg);
+static void skipEcgPacket(void); // drop the packet being filled in, its number is skipped
+static void queueEcgPacket(uint8 len);
+static bool isStackBusy(bStatus_t status);
+#if defined(ECG_LOG)
+static void saveEcgSignalLog(int16 ecg);
+static void saveRRLog(uint16 rr);
+static void writeRRLog(void);
+static void flushLog(void);
+#endif
+static void addMedianRR(uint16 rr); // add a RR interval to the median window and update the bpm
+static uint8 findSorted(uint16 rr); // the position of the first RR interval not less than rr in rrSort
+static void queueRRInterval(uint16 rr); // queue a RR interval in samples for the notification
+static int16 meanOf8(int *buf); // the mean of a detector buffer
 
 extern void HRFunc_Init(uint8 taskID)
 { 
   taskId = taskID;
   
   // initilize the ADS1x9x and set the data process callback function
-  ADS1x9x_Init(processEcgSignal); 
+  ADS1x9x_Init(pushEcgSignal); 
   
-  delayus(1000);
-  
-  QRSDet(0, 1);
+  QRSDetInit(&qrsDet, SAMPLERATE);
+  Sqi_Init(&sqi, SAMPLERATE, getClipCount(&qrsDet));
+#if defined(ECG_TPL)
+  BeatTpl_Init(&beatTpl, SAMPLERATE);
+#endif
+}
+
+extern void HRFunc_SetEcgPower(bool on)
+{
+  adsPower = on;
+  requestAdsCtrl();
 }
 
 extern void HRFunc_SetEcgSampling(bool start)
 {
-  if(start)
-  {
-    ADS1x9x_WakeUp(); 
-    // һҪʱ
-    delayus(1000);
-    ADS1x9x_StartConvert();
-    delayus(1000);
-  } 
-  else
+  // the contact is found again when started
+  osal_stop_timerEx(taskId, HRM_LOFF_POLL_EVT);
+  loffSuspend = false;
+  ecgContact = true;
+  loffNum = 0;
+  
+  adsSampling = start;
+  requestAdsCtrl();
+}
+
+// probe the leads while they are off: sample for a while to read the lead-off status
+extern void HRFunc_ProcessLeadOffPoll(void)
+{
+  if(ecgContact || !adsSampling) return;
+  
+  loffSuspend = false;
+  loffNum = 0;
+  probeNum = 0;
+  requestAdsCtrl();
+}
+
+// one step of the ADS1x9x control, from the current state towards adsPower and adsSampling
+// each step waits the ADS1x9x on the OSAL timer instead of a delay loop
+extern void HRFunc_ProcessAdsCtrl(void)
+{
+  uint16 wait = 0;
+  
+  adsWaiting = false;
+  
+  switch(adsState)
   {
-    ADS1x9x_StopConvert();
-    ADS1x9x_StandBy();
-    delayus(2000);
+    case ADS_STATE_OFF:
+      // the registers are set for SAMPLERATE when powered up
+      adsReconfig = false;
+      if(!adsPower) return;
+      ADS1x9x_PowerUp();
+      setEcgResolution(ADS1x9x_Is24Bit());
+#if defined(ECG_RESP)
+      respOn = ADS1x9x_HasResp();
+      respDecim = (uint8)(SAMPLERATE/RESP_RATE);
+#endif
+      adsState = ADS_STATE_UP;
+      wait = ADS_POWERUP_TIME;
+      break;
+      
+    case ADS_STATE_UP:
+      ADS1x9x_StandBy();
+      adsState = ADS_STATE_STANDBY;
+      wait = ADS_STANDBY_TIME;
+      break;
+      
+    case ADS_STATE_STANDBY:
+      if(!adsPower || adsReconfig)
+      {
+        ADS1x9x_PowerDown();
+        adsState = ADS_STATE_DOWN;
+        wait = ADS_POWERDOWN_TIME;
+      }
+      else if(adsSampling && !loffSuspend)
+      {
+        ADS1x9x_WakeUp(); 
+        adsState = ADS_STATE_AWAKE;
+        wait = ADS_WAKEUP_TIME;
+      }
+      else
+      {
+        return;
+      }
+      break;
+      
+    case ADS_STATE_AWAKE:
+      ADS1x9x_StartConvert();
+      adsState = ADS_STATE_SETTLING;
+      wait = ADS_SETTLE_TIME;
+      break;
+      
+    case ADS_STATE_SETTLING:
+      // discard the samples got while settling and those left from the last sampling
+      ringTail = ringHead;
+      ringDroppedSeen = ringDropped;
+      dcInit = true;
+#if defined(ECG_RESP)
+      respCnt = 0;
+      respAcc = 0;
+      respTail = respHead;
+      Resp_Init(&resp);
+#endif
+      if(rateChanged)
+      {
+        rateChanged = false;
+        HRFunc_SetHRCalcing(hrCalc);
+      }
+      adsState = ADS_STATE_SAMPLING;
+      break;
+      
+    case ADS_STATE_SAMPLING:
+      if(adsPower && adsSampling && !adsReconfig && !loffSuspend) return;
+      ADS1x9x_StopConvert();
+      ADS1x9x_StandBy();
+      adsState = ADS_STATE_STANDBY;
+      wait = ADS_STOP_TIME;
+      break;
+      
+    case ADS_STATE_DOWN:
+      adsState = ADS_STATE_OFF;
+      break;
   }
+  
+  // go on with the next step, the requests may have changed meanwhile
+  adsWaiting = true;
+  if(wait == 0)
+    osal_set_event(taskId, HRM_ADS_CTRL_EVT);
+  else
+    osal_start_timerEx(taskId, HRM_ADS_CTRL_EVT, wait);
+}
+
+// SAMPLERATE has changed, set the ADS1x9x again and restart the detector and the ecg packets
+// the ADS1x9x is powered down and up again with the registers for the new sample rate.
+// the samples at the old rate are discarded, and the detector is restarted when settled at the new rate
+extern void HRFunc_SetSampleRate(void)
+{
+  adsReconfig = true;
+  rateChanged = true;
+  requestAdsCtrl();
+  
+  HRFunc_SetEcgSending(ecgSend);
 }
 
 extern void HRFunc_SetHRCalcing(bool calc)
@@ -83,8 +402,22 @@ extern void HRFunc_SetHRCalcing(bool calc)
   {
     initBeat = 1;
     rrNum = 0; 
-    ecgProcess = false;
+    rrPos = 0;
+    curBPM = 0;
+    rrQTail = rrQHead;
+    Hrv_Init(&hrv);
+    // the sample rate may have changed with the work mode
+    QRSDetInit(&qrsDet, SAMPLERATE);
+    Sqi_Init(&sqi, SAMPLERATE, getClipCount(&qrsDet));
+#if defined(ECG_TPL)
+    BeatTpl_Init(&beatTpl, SAMPLERATE);
+#endif
   }
+#if defined(ECG_TPL)
+  tplSending = false;
+  osal_stop_timerEx(taskId, HRM_TPL_NOTI_EVT);
+#endif
+  sqiGood = true;
   hrCalc = calc;
 }
 
@@ -93,127 +426,489 @@ extern void HRFunc_SetEcgSending(bool send)
   if(send)
   {
     pckNum = 0;
-    pEcgBuff = ecgBuff;
+    packHead = packTail = 0;
+    pEcgBuff = ecgBuff[0];
+    EcgRice_Init(&rice, ECG_PACK_MAX_LEN);
+    osal_stop_timerEx(taskId, HRM_ECG_NOTI_EVT);
     osal_clear_event(taskId, HRM_ECG_NOTI_EVT);
+    osal_memset(&packLoad, 0, sizeof(HRFunc_EcgLoad_t));
   }
   ecgSend = send;
 }
 
+// set the ecg packet format, the packets not sent yet are discarded
+extern void HRFunc_SetEcgPackFormat(uint8 format)
+{
+  packFormat = format;
+  HRFunc_SetEcgSending(ecgSend);
+}
+
+// send the queued ecg packets, as many as the stack accepts in this connection event
 extern void HRFunc_SendEcgPacket(uint16 connHandle)
 {
-  ECG_PacketNotify( connHandle, &ecgNoti );
+  bStatus_t status;
+  
+  while(packTail != packHead)
+  {
+    osal_memcpy(ecgNoti.value, ecgBuff[packTail & ECG_PACK_QUEUE_MASK], packLen[packTail & ECG_PACK_QUEUE_MASK]);
+    ecgNoti.len = packLen[packTail & ECG_PACK_QUEUE_MASK];
+    status = ECG_PacketNotify( connHandle, &ecgNoti );
+    
+    if(isStackBusy(status))
+    {
+      packLoad.busy++;
+      // the stack buffers are all in use, try again when some are released
+      osal_start_timerEx(taskId, HRM_ECG_NOTI_EVT, ECG_NOTI_RETRY_PERIOD);
+      return;
+    }
+    
+    // sent, or it can not be sent at all, e.g. the notification is disabled
+#if defined(ENERGY_PROFILE)
+    if(status == SUCCESS) Energy_AddPacket();
+#endif
+    packTail++;
+  }
+}
+
+// get the ecg packet load and restart counting it
+extern void HRFunc_GetEcgLoad(HRFunc_EcgLoad_t* pLoad)
+{
+  *pLoad = packLoad;
+  osal_memset(&packLoad, 0, sizeof(HRFunc_EcgLoad_t));
+}
+
+#if defined(ECG_LOG)
+// log the ecg and the RR intervals in the flash, e.g. when disconnected
+extern void HRFunc_SetEcgLogging(bool log)
+{
+  if(log && !ecgLog)
+  {
+    EcgRice_Init(&logRice, ECG_LOG_REC_LEN-1);
+    logRrNum = 0;
+  }
+  else if(!log && ecgLog)
+  {
+    flushLog();
+  }
+  ecgLog = log;
+}
+
+// start or stop downloading the log
+extern void HRFunc_SetLogDownload(bool start)
+{
+  if(start)
+  {
+    EcgLog_Rewind();
+    logPending = false;
+    osal_set_event(taskId, HRM_LOG_NOTI_EVT);
+  }
+  else
+  {
+    osal_stop_timerEx(taskId, HRM_LOG_NOTI_EVT);
+  }
+  logDownload = start;
+  ECGLog_SetParameter(ECGLOG_DOWNLOADING, sizeof(uint8), &start);
+}
+
+// send the log records, as many as the stack accepts in this connection event
+// the download ends with a 1 byte ECG_LOG_REC_END notification
+extern void HRFunc_SendLogRecords(uint16 connHandle)
+{
+  bStatus_t status;
+  
+  while(logDownload)
+  {
+    if(!logPending)
+    {
+      if(EcgLog_Read(logNoti.value))
+      {
+        logNoti.len = ECG_LOG_REC_LEN;
+      }
+      else
+      {
+        logNoti.value[0] = ECG_LOG_REC_END;
+        logNoti.len = 1;
+      }
+      logPending = true;
+    }
+    
+    status = ECGLog_DataNotify( connHandle, &logNoti );
+    if(isStackBusy(status))
+    {
+      osal_start_timerEx(taskId, HRM_LOG_NOTI_EVT, ECG_NOTI_RETRY_PERIOD);
+      return;
+    }
+    logPending = false;
+    
+    if(status != SUCCESS || logNoti.len == 1)
+    {
+      HRFunc_SetLogDownload(false);
+    }
+  }
 }
+#endif
 
 // send HR packet
+// all the RR intervals since the last packet are sent, in more packets if they do not fit in one.
+// the RR intervals not sent because the stack is busy are sent with the next packet
 extern void HRFunc_SendHRPacket(uint16 connHandle)
 {
-  if(rrNum == 0) return;  // No RR interval, return
+  uint8 num, i;
+  uint8* p;
+  bStatus_t status;
+  uint8 flags = (ecgContact ? HRM_FLAGS_CONTACT_DET : HRM_FLAGS_CONTACT_NOT_DET);
   
-  uint8* p = hrNoti.value;
-  uint8* pTmp = p;
+  // the bpm is the median of the last RR intervals, updated per beat,
+  // so only the new RR intervals or a contact change are needed to send a packet
+  if(rrQHead == rrQTail && ecgContact == contactSent) return;  // No RR interval, return
   
-  //////// Two methods to calculate BPM
-  // 1. using average method
-  /*
-  int32 sum = 0;
-  for(i = 0; i < rrNum; i++)
-  {
-    sum += rrBuf[i];
-  }
-  int16 BPM = (7500L*rrNum + (sum>>1))/sum; // BPM = (60*1000ms)/(RRInterval*8ms) = 7500/RRInterval, the round op is done
-  */
-  
-  // 2. using median method
-  uint16 rrMedian = ((rrNum == 1) ? rrBuf[0] : median(rrBuf, rrNum));
-  int16 BPM = 7500/rrMedian; // BPM = (60*1000ms)/(RRInterval*8ms) = 7500/RRInterval
-  ////////////////////////////////////////
-  
-  if(BPM > 255) BPM = 255;
-  
-  ////////Three different way to output HR data
-  
-  //1. bpm only
-  *p++ = 0x00;
-  *p++ = (uint8)BPM;
-  
-
-  //2. bpm and RRInterval
-  /*
-  *p++ = 0x10;
-  *p++ = (uint8)BPM;
-  uint16 MS1024 = 0;
-  for(int i = 0; i < rrNum; i++)
-  {
-    // MS1024 = (uint16)(rrBuf[i]*8.192); // transform into the number with 1/1024 second unit, which is required in BLE.
-    // *p++ = LO_UINT16(MS1024);
-    // *p++ = HI_UINT16(MS1024);
-    *p++ = LO_UINT16(rrBuf[i]);
-    *p++ = HI_UINT16(rrBuf[i]);
-  }
-  */
-  
-  /*
-  // 3. bpm and Q&N as RRInterval for debug
-  *p++ = 0x10;
-  *p++ = (uint8)BPM;
-  int* pQRS = getQRSBuffer();
-  int* pNoise = getNoiseBuffer();
-  *p++ = LO_UINT16(*pQRS);
-  *p++ = HI_UINT16(*pQRS++);
-  *p++ = LO_UINT16(*pQRS);
-  *p++ = HI_UINT16(*pQRS++);
-  *p++ = LO_UINT16(*pQRS);
-  *p++ = HI_UINT16(*pQRS++);
-  *p++ = LO_UINT16(*pQRS);
-  *p++ = HI_UINT16(*pQRS++);
-  *p++ = LO_UINT16(*pNoise);
-  *p++ = HI_UINT16(*pNoise++);
-  *p++ = LO_UINT16(*pNoise);
-  *p++ = HI_UINT16(*pNoise++);
-  *p++ = LO_UINT16(*pNoise);
-  *p++ = HI_UINT16(*pNoise++);
-  *p++ = LO_UINT16(*pNoise);
-  *p++ = HI_UINT16(*pNoise++);  
-  */
-  
-  hrNoti.len = (uint8)(p-pTmp);
-  HRM_MeasNotify( connHandle, &hrNoti );
-  rrNum = 0;
-}
-
-static void processEcgSignal(int16 x)
-{
-  if(SAMPLERATE == HR_MODE_SAMPLERATE)
-    ecgProcess = true;
-  else {
-    ecgProcess = !ecgProcess;
-  }
-  
-  if(ecgProcess && hrCalc) // need calculate HR
-  {
-    if(QRSDet(x, 0))
+  do
+  {
+    p = hrNoti.value;
+    num = (uint8)(rrQHead - rrQTail);
+    if(num > HR_PACK_RR_NUM) num = HR_PACK_RR_NUM;
+    *p++ = (num != 0) ? (flags | HRM_FLAGS_RR) : flags;
+    *p++ = curBPM;
+    for(i = 0; i < num; i++)
+    {
+      uint16 rr = rrQueue[(uint8)(rrQTail+i) & RR_QUEUE_MASK];
+      *p++ = LO_UINT16(rr);
+      *p++ = HI_UINT16(rr);
+    }
+    hrNoti.len = (uint8)(p-hrNoti.value);
+    status = HRM_MeasNotify( connHandle, &hrNoti );
+    if(isStackBusy(status)) break; // keep the RR intervals for the next packet
+    if(status != SUCCESS)
+    {
+      // it can not be sent at all, e.g. the notification is disabled, drop the RR intervals
+      rrQTail = rrQHead;
+      break;
+    }
+    rrQTail += num;
+    contactSent = ecgContact;
+  } while(rrQHead != rrQTail);
+}
+
+// end the signal quality window and send the SQI packet, it is also kept for reading.
+// the ecg is sent in the next window only if the signal quality is good
+extern void HRFunc_SendSqiPacket(uint16 connHandle)
+{
+  uint8 buf[SQI_PACK_LEN];
+  bool good;
+  
+  if(!hrCalc) return;
+  
+  good = (Sqi_EndWindow(&sqi, getClipCount(&qrsDet)) >= SQI_ECG_MIN);
+  // the samples before and after the muted windows must not share a packet,
+  // the skipped packet number shows the gap to the receiver
+  if(sqiGood && !good && ecgSend) skipEcgPacket();
+  sqiGood = good;
+  ECG_SetParameter(ECG_SQI, Sqi_Pack(&sqi, buf), buf);
+  ECG_SqiNotify(connHandle);
+}
+
+#if defined(ECG_TPL)
+// start sending the beat template averaged since it was sent last, the beats are not added until it is sent
+extern void HRFunc_StartTplSending(void)
+{
+  if(!hrCalc || tplSending || beatTpl.num == 0) return;
+  
+  BeatTpl_Hold(&beatTpl, true);
+  tplPackNum = 0;
+  tplSending = true;
+  osal_set_event(taskId, HRM_TPL_NOTI_EVT);
+}
+
+// send the beat template packets, as many as the stack accepts in this connection event
+extern void HRFunc_SendTplPackets(uint16 connHandle)
+{
+  bStatus_t status;
+  
+  while(tplSending)
+  {
+    tplNoti.len = BeatTpl_Pack(&beatTpl, tplPackNum, tplNoti.value);
+    status = ECG_BeatTplNotify( connHandle, &tplNoti );
+    if(isStackBusy(status))
+    {
+      osal_start_timerEx(taskId, HRM_TPL_NOTI_EVT, ECG_NOTI_RETRY_PERIOD);
+      return;
+    }
+    
+    // the next template is averaged from the beats after this one
+    if(status != SUCCESS || ++tplPackNum >= BEAT_TPL_PACK_NUM)
+    {
+      BeatTpl_Clear(&beatTpl);
+      BeatTpl_Hold(&beatTpl, false);
+      tplSending = false;
+    }
+  }
+}
+#endif
+
+// send HRV packet, it is also kept for reading
+extern void HRFunc_SendHrvPacket(uint16 connHandle)
+{
+  uint8 buf[HRV_PACK_LEN];
+  
+  ECG_SetParameter(ECG_HRV, Hrv_Pack(&hrv, buf), buf);
+  ECG_HrvNotify(connHandle);
+}
+
+#if defined(ECG_RESP)
+// send the breathing rate packet, it is also kept for reading
+extern void HRFunc_SendRespPacket(uint16 connHandle)
+{
+  uint8 buf[RESP_PACK_LEN];
+  
+  if(!respOn) return;
+  
+  ECG_SetParameter(ECG_RESP_RATE, Resp_Pack(&resp, buf), buf);
+  ECG_RespNotify(connHandle);
+}
+#endif
+
+// process the ecg samples buffered by the DRDY ISR
+extern void HRFunc_ProcessEcgData(void)
+{
+  uint8 tail = ringTail;
+  
+  // not settled yet, or still at the old sample rate, the samples are discarded when settled
+  if(adsState != ADS_STATE_SAMPLING || adsReconfig) return;
+  
+  // samples were lost, so the next RR interval will be wrong
+  // and the HRV successive differences would span the gap
+  if(ringDropped != ringDroppedSeen)
+  {
+    ringDroppedSeen = ringDropped;
+    initBeat = 1;
+    Hrv_Init(&hrv);
+  }
+  
+  while(tail != ringHead)
+  {
+    processEcgSignal(ecgRing[tail & ECG_RING_MASK], ecgLoff[tail & ECG_RING_MASK]);
+    ringTail = ++tail;
+  }
+  
+#if defined(ECG_RESP)
+  // the respiration is in the same batch, at a lower rate
+  tail = respTail;
+  while(tail != respHead)
+  {
+    if(ecgContact)
+      Resp_Add(&resp, (int16)(respRing[tail & RESP_RING_MASK] / respDecim));
+    respTail = ++tail;
+  }
+#endif
+}
+
+// run the ADS1x9x control if it is not waiting on the timer
+static void requestAdsCtrl(void)
+{
+  if(!adsWaiting)
+  {
+    adsWaiting = true;
+    osal_set_event(taskId, HRM_ADS_CTRL_EVT);
+  }
+}
+
+// the 16 bits samples are the same as the chip gives.
+// the 24 bits samples keep ECG_24BIT_EXTRA_BITS more bits, so the 1mV calibration value
+// is larger and the QRS detector gets them shifted back to the 16 bits scale
+static void setEcgResolution(bool res24)
+{
+  uint16 cali = ECG_1MV_CALI_VALUE;
+  
+  ecgRes24 = res24;
+  if(res24) cali <<= ECG_24BIT_EXTRA_BITS;
+  ECG_SetParameter( ECG_1MV_CALI, sizeof ( uint16 ), &cali );
+}
+
+// called in the DRDY ISR: only put the sample into the ring buffer
+static void pushEcgSignal(int32 x, int32 r, uint8 loffStat)
+{
+  uint8 head = ringHead;
+  uint8 num = (uint8)(head - ringTail);
+  
+#if defined(ECG_RESP)
+  if(respOn) pushRespSignal(r);
+#endif
+  
+  if(num >= ECG_RING_LEN)
+  {
+    ringDropped++;
+    return;
+  }
+  
+  ecgRing[head & ECG_RING_MASK] = x;
+  ecgLoff[head & ECG_RING_MASK] = loffStat & ADS1x9x_LOFF_CH1;
+  ringHead = head+1;
+  
+  if(num+1 >= ECG_BATCH_LEN)
+    osal_set_event(taskId, HRM_ECG_DATA_EVT);
+}
+
+#if defined(ECG_RESP)
+// sum the respiration samples in the 16 bits scale and put the sum into the ring when decimated
+static void pushRespSignal(int32 r)
+{
+  uint8 head = respHead;
+  
+  respAcc += (r >> 8);
+  if(++respCnt < respDecim) return;
+  
+  if((uint8)(head - respTail) < RESP_RING_LEN)
+  {
+    respRing[head & RESP_RING_MASK] = respAcc;
+    respHead = head+1;
+  }
+  respAcc = 0;
+  respCnt = 0;
+}
+#endif
+
+// with the extra bits the 16 bits ecg samples cover a smaller input range,
+// so the electrode DC offset is removed first to keep the signal in the range
+static int16 scaleEcgSignal(int32 x)
+{
+  int32 y;
+  
+  if(!ecgRes24) return (int16)(x >> 8);
+  
+  if(dcInit)
+  {
+    dcInit = false;
+    dcLast = x;
+    dcAcc = 0;
+  }
+  dcAcc += ((x - dcLast) << ECG_DC_FRAC_BITS) - (dcAcc >> ECG_DC_SHIFT);
+  dcLast = x;
+  
+  y = dcAcc >> (ECG_DC_FRAC_BITS + 8 - ECG_24BIT_EXTRA_BITS);
+  if(y > 32767) return 32767;
+  if(y < -32768) return -32768;
+  return (int16)y;
+}
+
+static void processEcgSignal(int32 raw, uint8 loff)
+{
+  int16 x, d;
+  int *pQRS;
+  uint16 delay;
+  
+  // nothing is done with the noise got while the leads are off
+  if(!checkContact(loff)) return;
+  
+  x = scaleEcgSignal(raw);
+  
+  if(hrCalc) // need calculate HR
+  {
+    d = ecgRes24 ? (x >> ECG_24BIT_EXTRA_BITS) : x;
+    Sqi_AddSample(&sqi, d);
+#if defined(ECG_TPL)
+    BeatTpl_AddSample(&beatTpl, x);
+#endif
+    // the detector gives the delay from the R peak
+    delay = (uint16)QRSDet(&qrsDet, d, 0);
+    if(delay)
     {
+      // the new QRS peak is the first of the QRS buffer
+      pQRS = getQRSBuffer(&qrsDet);
+      Sqi_AddBeat(&sqi, pQRS[0], meanOf8(pQRS), meanOf8(getNoiseBuffer(&qrsDet)));
+#if defined(ECG_TPL)
+      // only the good beats are averaged
+      if(sqiGood && sqi.beatSqi >= SQI_ECG_MIN) BeatTpl_AddBeat(&beatTpl, delay);
+#endif
+      
       if(initBeat) 
       {
         initBeat = 0;
       }
       else
       {
-        rrBuf[rrNum++] = getRRInterval();
-        if(rrNum >= 9) rrNum = 8;
+        uint16 rr = getRRInterval(&qrsDet);
+        addMedianRR(rr);
+        queueRRInterval(rr);
+        Hrv_AddRR(&hrv, (uint16)(((uint32)rr*1000 + (SAMPLERATE >> 1)) / SAMPLERATE));
+#if defined(ECG_LOG)
+        if(ecgLog) saveRRLog(rr);
+#endif
       }
     }
   }
   
-  if(ecgSend) // need send ecg
+#if defined(ECG_LOG)
+  if(ecgLog) // need log ecg
+  {
+    saveEcgSignalLog(x);
+  }
+#endif
+  
+  if(ecgSend && sqiGood) // need send ecg, not during motion artifacts
+  {
+    if(packFormat == ECG_PACK_FORMAT_RICE)
+      saveEcgSignalRice(x);
+    else
+      saveEcgSignal(x);
+  }
+}
+
+// the contact is lost after LOFF_OFF_NUM lead-off samples, then the sampling is suspended
+// and probed every LOFF_POLL_PERIOD, the contact is found after LOFF_ON_NUM lead-on samples
+static bool checkContact(uint8 loff)
+{
+  if(ecgContact)
+  {
+    if(!loff)
+    {
+      loffNum = 0;
+      return true;
+    }
+    if(++loffNum < LOFF_OFF_NUM) return true;
+    
+    // contact lost, the beats before and after the gap are not used together
+    ecgContact = false;
+    loffNum = 0;
+    initBeat = 1;
+    rrNum = 0;
+    rrPos = 0;
+    curBPM = 0;
+    Hrv_Init(&hrv);
+    suspendSampling();
+    return false;
+  }
+  
+  if(loff)
+  {
+    loffNum = 0;
+  }
+  else if(++loffNum >= LOFF_ON_NUM)
   {
-    saveEcgSignal(x);
+    // contact found
+    ecgContact = true;
+    loffNum = 0;
+    initBeat = 1;
+    dcInit = true;
+    return true;
   }
+  
+  if(!loffSuspend && ++probeNum >= LOFF_PROBE_NUM) suspendSampling();
+  return false;
+}
+
+static void suspendSampling(void)
+{
+  loffSuspend = true;
+  probeNum = 0;
+  requestAdsCtrl();
+  osal_start_timerEx(taskId, HRM_LOFF_POLL_EVT, LOFF_POLL_PERIOD);
 }
 
 static void saveEcgSignal(int16 ecg)
 {
-  if(pEcgBuff == ecgBuff)
+  uint8* pPack = ecgBuff[packHead & ECG_PACK_QUEUE_MASK];
+  
+  if(pEcgBuff == pPack)
   {
     *pEcgBuff++ = pckNum;
     pckNum = (pckNum == ECG_MAX_PACK_NUM) ? 0 : pckNum+1;
@@ -221,72 +916,184 @@ static void saveEcgSignal(int16 ecg)
   *pEcgBuff++ = LO_UINT16(ecg);  
   *pEcgBuff++ = HI_UINT16(ecg);
   
-  if(pEcgBuff-ecgBuff >= ECG_PACK_BYTE_NUM)
+  if(pEcgBuff-pPack >= ECG_PACK_BYTE_NUM)
+  {
+    queueEcgPacket(ECG_PACK_BYTE_NUM);
+    pEcgBuff = ecgBuff[packHead & ECG_PACK_QUEUE_MASK];
+  }
+}
+
+// code the ecg signal into Rice packets, a packet is closed when the next sample does not fit
+static void saveEcgSignalRice(int16 ecg)
+{
+  if(rice.n != 0)
+  {
+    if(EcgRice_Add(&rice, ecg)) return;
+    queueEcgPacket(EcgRice_End(&rice));
+  }
+  
+  EcgRice_Begin(&rice, ecgBuff[packHead & ECG_PACK_QUEUE_MASK], pckNum, ecg);
+  pckNum = (pckNum == ECG_MAX_PACK_NUM) ? 0 : pckNum+1;
+}
+
+static void skipEcgPacket(void)
+{
+  uint8* pPack = ecgBuff[packHead & ECG_PACK_QUEUE_MASK];
+  
+  // the number of a packet begun is already taken
+  if(packFormat == ECG_PACK_FORMAT_RICE && rice.n != 0)
+    rice.n = 0;
+  else if(packFormat != ECG_PACK_FORMAT_RICE && pEcgBuff != pPack)
+    pEcgBuff = pPack;
+  else
+    pckNum = (pckNum == ECG_MAX_PACK_NUM) ? 0 : pckNum+1;
+}
+
+// is the status returned because the stack has no buffer for a notification now
+static bool isStackBusy(bStatus_t status)
+{
+  return (status == MSG_BUFFER_NOT_AVAIL || status == bleNoResources || status == bleMemAllocError);
+}
+
+#if defined(ECG_LOG)
+// code the logged ecg into Rice packets and append each of them to the log as a record
+static void saveEcgSignalLog(int16 ecg)
+{
+  if(logRice.n != 0)
+  {
+    if(EcgRice_Add(&logRice, ecg)) return;
+    EcgRice_End(&logRice);
+    EcgLog_Append(logRec);
+  }
+  
+  logRec[0] = ECG_LOG_REC_ECG;
+  EcgRice_Begin(&logRice, logRec+1, logPckNum++, ecg);
+}
+
+static void saveRRLog(uint16 rr)
+{
+  logRr[logRrNum++] = rr;
+  if(logRrNum >= ECG_LOG_RR_NUM) writeRRLog();
+}
+
+// append the RR intervals in logRr to the log
+static void writeRRLog(void)
+{
+  uint8 rec[ECG_LOG_REC_LEN];
+  uint8 i;
+  
+  osal_memset(rec, 0, ECG_LOG_REC_LEN);
+  rec[0] = ECG_LOG_REC_RR;
+  rec[1] = logRrNum;
+  rec[2] = LO_UINT16(SAMPLERATE);
+  rec[3] = HI_UINT16(SAMPLERATE);
+  for(i = 0; i < logRrNum; i++)
   {
-    osal_memcpy(ecgNoti.value, ecgBuff, ECG_PACK_BYTE_NUM);
-    ecgNoti.len = ECG_PACK_BYTE_NUM;
-    osal_set_event(taskId, HRM_ECG_NOTI_EVT);
-    pEcgBuff = ecgBuff;
+    rec[4+2*i] = LO_UINT16(logRr[i]);
+    rec[5+2*i] = HI_UINT16(logRr[i]);
   }
+  EcgLog_Append(rec);
+  logRrNum = 0;
 }
 
-static uint16 median(uint16 *array, uint8 datnum)
+// log the ecg packet and the RR intervals not full yet
+static void flushLog(void)
+{
+  if(logRice.n != 0)
+  {
+    EcgRice_End(&logRice);
+    EcgLog_Append(logRec);
+  }
+  if(logRrNum != 0)
+  {
+    writeRRLog();
+  }
+}
+#endif
+
+// queue the packet filled in and ask for sending it
+static void queueEcgPacket(uint8 len)
+{
+  uint8 num;
+  
+  packLen[packHead & ECG_PACK_QUEUE_MASK] = len;
+  packHead++;
+  packLoad.queued++;
+  if((uint8)(packHead-packTail) > ECG_PACK_QUEUE_LEN-1)
+  {
+    // keep one packet free for filling in, drop the oldest one
+    // the receiver sees the gap in the packet numbers
+    packTail++;
+    packDropped++;
+    packLoad.dropped++;
+  }
+  num = (uint8)(packHead-packTail);
+  if(num > packLoad.maxQueued) packLoad.maxQueued = num;
+  if(num >= ECG_PACK_QUEUE_LEN-1) packLoad.full = true;
+  osal_set_event(taskId, HRM_ECG_NOTI_EVT);
+}
+
+static void queueRRInterval(uint16 rr)
+{
+  // the queue holds more than ten seconds of beats, it is full only if the stack
+  // has been busy that long, then the oldest RR interval is dropped
+  if((uint8)(rrQHead - rrQTail) >= RR_QUEUE_LEN)
+    rrQTail++;
+  // transform into the number with 1/1024 second unit, which is required in BLE.
+  rrQueue[rrQHead & RR_QUEUE_MASK] = (uint16)((((uint32)rr << 10) + (SAMPLERATE >> 1)) / SAMPLERATE);
+  rrQHead++;
+}
+
+static int16 meanOf8(int *buf)
+{
+  uint8 i;
+  int32 sum = 0;
+  
+  for(i = 0; i < 8; i++)
+    sum += buf[i];
+  return (int16)(sum >> 3);
+}
+
+// the oldest RR interval is taken out of rrSort and the new one put in with a binary search,
+// so a beat moves at most HR_MEDIAN_LEN values and no sort is done
+static void addMedianRR(uint16 rr)
 {
   uint8 i, j;
-  uint8 half = ((datnum-2)>>1);
-  uint16 tmp, sort[RRBUF_LEN] ;
-  osal_memcpy(sort, array, 2*datnum); // the length unit is BYTE not uint16
-  // sort array using up-order
-  // only half of data need to be sorted to find out the median
-  for(i = 0; i <= half; ++i)
-  {
-    for(j = i+1; j < datnum; j++)
-    {
-      if(sort[j] > sort[i])
-      {
-        tmp = sort[i];
-        sort[i] = sort[j];
-        sort[j] = tmp;
-      }
-    }
+  
+  if(rrNum == HR_MEDIAN_LEN)
+  {
+    // take the oldest out
+    i = findSorted(rrWin[rrPos]);
+    rrNum--;
+    for(; i < rrNum; i++)
+      rrSort[i] = rrSort[i+1];
+  }
+  
+  // put the new one in
+  j = findSorted(rr);
+  for(i = rrNum; i > j; i--)
+    rrSort[i] = rrSort[i-1];
+  rrSort[j] = rr;
+  rrNum++;
+  
+  rrWin[rrPos] = rr;
+  if(++rrPos >= HR_MEDIAN_LEN) rrPos = 0;
+  
+  // the lower median if rrNum is even
+  curBPM = Bpm_FromRR(rrSort[(rrNum-1)>>1], SAMPLERATE);
+}
+
+static uint8 findSorted(uint16 rr)
+{
+  uint8 lo = 0, hi = rrNum, mid;
+  
+  while(lo < hi)
+  {
+    mid = (lo+hi)>>1;
+    if(rrSort[mid] < rr)
+      lo = mid+1;
+    else
+      hi = mid;
   }
-  return(sort[half]);
-}
-
-//static void processTestSignal(int16 x)
-//{
-//  static int16 data1mV[125] = {0};
-//  static uint8 index = 0;
-//  uint8 i,j;
-//  
-//  data1mV[index++] = x;
-//  
-//  if(index >= SAMPLERATE)
-//  {
-//    uint16 tmp; 
-//    for(i = 0; i < SAMPLERATE; ++i)
-//    {
-//      for(j = i+1; j < SAMPLERATE; j++)
-//      {
-//        if(data1mV[j] < data1mV[i])
-//        {
-//          tmp = data1mV[i];
-//          data1mV[i] = data1mV[j];
-//          data1mV[j] = tmp;
-//        }
-//      }
-//    }
-//    long smin = 0;
-//    long smax = 0;
-//    for(i = 25; i < 35; i++)
-//    {
-//      smin += data1mV[i];
-//    }
-//    for(i = 90; i < 100; i++)
-//    {
-//      smax += data1mV[i];
-//    }
-//    caliValue = (smax-smin)/20;
-//    index = 0;
-//  }
-//}
\ No newline at end of file
+  return lo;
+}
@@ -8,11 +8,42 @@
 
 #include "hal_types.h"
 
+// ecg packet load since the last HRFunc_GetEcgLoad
+typedef struct
+{
+  uint16 queued;    // the number of packets queued
+  uint16 dropped;   // the number of packets dropped because the queue was full
+  uint16 busy;      // the number of times the stack had no buffer for a packet
+  uint8 maxQueued;  // max number of packets waiting in the queue
+  bool full;        // was the queue full
+} HRFunc_EcgLoad_t;
+
 extern void HRFunc_Init(uint8 taskID); //init
+extern void HRFunc_SetEcgPower(bool on); // is the ADS1x9x powered
 extern void HRFunc_SetEcgSampling(bool start); // is the ecg sampling started
+extern void HRFunc_ProcessLeadOffPoll(void); // probe the leads while they are off
+extern void HRFunc_ProcessAdsCtrl(void); // run one step of the ADS1x9x power/start/stop control
+extern void HRFunc_SetSampleRate(void); // SAMPLERATE has changed
 extern void HRFunc_SetHRCalcing(bool calc); // is the Heart rate calculated?
 extern void HRFunc_SetEcgSending(bool send); // is the ecg data sent?
+extern void HRFunc_SetEcgPackFormat(uint8 format); // set the ecg packet format
 extern void HRFunc_SendHRPacket(uint16 connHandle); // send HR packet
+extern void HRFunc_SendHrvPacket(uint16 connHandle); // send HRV packet
+extern void HRFunc_SendSqiPacket(uint16 connHandle); // end the signal quality window and send SQI packet
+#if defined(ECG_TPL)
+extern void HRFunc_StartTplSending(void); // start sending the averaged beat template
+extern void HRFunc_SendTplPackets(uint16 connHandle); // send beat template packets
+#endif
+#if defined(ECG_RESP)
+extern void HRFunc_SendRespPacket(uint16 connHandle); // send breathing rate packet
+#endif
 extern void HRFunc_SendEcgPacket(uint16 connHandle); // send ecg packet
+extern void HRFunc_GetEcgLoad(HRFunc_EcgLoad_t* pLoad); // get the ecg packet load and restart counting it
+extern void HRFunc_ProcessEcgData(void); // process the ecg samples buffered by the DRDY ISR
+#if defined(ECG_LOG)
+extern void HRFunc_SetEcgLogging(bool log); // is the ecg and RR logged in the flash?
+extern void HRFunc_SetLogDownload(bool start); // start or stop downloading the log
+extern void HRFunc_SendLogRecords(uint16 connHandle); // send log records
+#endif
 
 #endif
\ No newline at end of file
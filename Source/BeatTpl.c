@@ -0,0 +1,187 @@
+/*
+ * BeatTpl.c : averaged beat template and its morphology
+ */
+
+#include "BeatTpl.h"
+#include "OSAL.h"
+
+#define HIST_MASK           (BEAT_TPL_HIST_LEN-1)
+#define HIST(t, i)          ((t)->hist[(uint16)(i) & HIST_MASK])
+#define BEAT_TPL_ISO_OFS    10 // the PR level is the mean of 4 samples ending 80ms before the R peak
+#define BEAT_TPL_QRS_HALF   12 // the QRS slopes are searched 96ms on each side of the R peak
+#define BEAT_TPL_ST_OFS     8  // the ST level is 64ms after the QRS offset
+
+static void addWindow(BeatTpl_t *t); // add the window of the pending beat to the sums
+static int16 isoLevel(BeatTpl_t *t, uint16 r); // the PR level before the history place r
+static int16 tplAt(BeatTpl_t *t, uint8 i); // the template sample i
+static int16 tplSlope(BeatTpl_t *t, uint8 i); // the template slope at the sample i
+
+extern void BeatTpl_Init(BeatTpl_t *t, uint16 sampleRate)
+{
+  osal_memset(t, 0, sizeof(BeatTpl_t));
+  t->decim = (sampleRate > BEAT_TPL_RATE) ? (uint8)(sampleRate / BEAT_TPL_RATE) : 1;
+}
+
+extern void BeatTpl_Clear(BeatTpl_t *t)
+{
+  t->num = 0;
+  osal_memset(t->sum, 0, sizeof(t->sum));
+}
+
+extern void BeatTpl_Hold(BeatTpl_t *t, bool hold)
+{
+  t->hold = hold;
+}
+
+extern void BeatTpl_AddSample(BeatTpl_t *t, int16 x)
+{
+  t->decimAcc += x;
+  if(++t->decimNum < t->decim) return;
+
+  HIST(t, t->histNum) = (int16)(t->decimAcc / t->decim);
+  t->histNum++;
+  t->decimAcc = 0;
+  t->decimNum = 0;
+
+  if(t->pending && (uint16)(t->histNum - t->rPos) > BEAT_TPL_POST+BEAT_TPL_ALIGN)
+    addWindow(t);
+}
+
+extern void BeatTpl_AddBeat(BeatTpl_t *t, uint16 delay)
+{
+  delay /= t->decim;
+
+  // a beat comes before the window of the last one is added only above 150bpm, then it is dropped.
+  // a beat found by the search back is too old for the history
+  if(t->pending || delay + BEAT_TPL_PRE + 2*BEAT_TPL_ALIGN >= BEAT_TPL_HIST_LEN) return;
+
+  t->rPos = t->histNum - 1 - delay;
+  t->pending = TRUE;
+  if((uint16)(t->histNum - t->rPos) > BEAT_TPL_POST+BEAT_TPL_ALIGN)
+    addWindow(t);
+}
+
+extern uint8 BeatTpl_Pack(BeatTpl_t *t, uint8 k, uint8 *pBuf)
+{
+  uint8 i, n, on, off, stPos;
+  int16 iso, rAmp, st, d, dMax;
+  int32 sum;
+  uint8 *p = pBuf;
+
+  *p++ = k;
+
+  if(k != 0)
+  {
+    i = (k-1)*BEAT_TPL_PACK_SAMPLES;
+    for(n = 0; n < BEAT_TPL_PACK_SAMPLES && i < BEAT_TPL_LEN; n++, i++)
+    {
+      d = tplAt(t, i);
+      *p++ = LO_UINT16(d);
+      *p++ = HI_UINT16(d);
+    }
+    return (uint8)(p - pBuf);
+  }
+
+  sum = 0;
+  for(i = BEAT_TPL_PRE-BEAT_TPL_ISO_OFS-3; i <= BEAT_TPL_PRE-BEAT_TPL_ISO_OFS; i++)
+    sum += tplAt(t, i);
+  iso = (int16)(sum >> 2);
+  rAmp = tplAt(t, BEAT_TPL_PRE) - iso;
+
+  // the QRS edges are where the slope falls below 1/8 of the steepest QRS slope
+  dMax = 0;
+  for(i = BEAT_TPL_PRE-BEAT_TPL_QRS_HALF; i <= BEAT_TPL_PRE+BEAT_TPL_QRS_HALF; i++)
+  {
+    d = tplSlope(t, i);
+    if(d < 0) d = -d;
+    if(d > dMax) dMax = d;
+  }
+  dMax >>= 3;
+  on = BEAT_TPL_PRE-BEAT_TPL_QRS_HALF;
+  off = BEAT_TPL_PRE+BEAT_TPL_QRS_HALF;
+
+  // the onset is the last flat sample before the steep part up to the R peak
+  for(i = BEAT_TPL_PRE-BEAT_TPL_QRS_HALF; i < BEAT_TPL_PRE; i++)
+  {
+    d = tplSlope(t, i);
+    if(d < 0) d = -d;
+    if(d <= dMax) on = i;
+    else break;
+  }
+  // the offset is the first flat sample after the last steep part
+  for(i = BEAT_TPL_PRE+BEAT_TPL_QRS_HALF; i > BEAT_TPL_PRE; i--)
+  {
+    d = tplSlope(t, i);
+    if(d < 0) d = -d;
+    if(d <= dMax) off = i;
+    else break;
+  }
+  stPos = off + BEAT_TPL_ST_OFS;
+  if(stPos >= BEAT_TPL_LEN) stPos = BEAT_TPL_LEN-1;
+  st = tplAt(t, stPos) - iso;
+
+  *p++ = LO_UINT16(t->num);
+  *p++ = HI_UINT16(t->num);
+  *p++ = LO_UINT16(rAmp);
+  *p++ = HI_UINT16(rAmp);
+  *p++ = (uint8)((off - on) * (1000/BEAT_TPL_RATE));
+  *p++ = LO_UINT16(st);
+  *p++ = HI_UINT16(st);
+  *p++ = BEAT_TPL_RATE;
+  *p++ = BEAT_TPL_PRE;
+  *p++ = BEAT_TPL_LEN;
+  return (uint8)(p - pBuf);
+}
+
+// the R peak is aligned on the largest deviation from the PR level
+static void addWindow(BeatTpl_t *t)
+{
+  int8 k;
+  uint8 i;
+  int16 iso, dev, devMax = -1;
+  uint16 r = t->rPos, place;
+
+  t->pending = FALSE;
+  if(t->hold || t->num >= BEAT_TPL_MAX_NUM) return;
+
+  iso = isoLevel(t, r);
+  place = r;
+  for(k = -BEAT_TPL_ALIGN; k <= BEAT_TPL_ALIGN; k++)
+  {
+    dev = HIST(t, r+k) - iso;
+    if(dev < 0) dev = -dev;
+    if(dev > devMax)
+    {
+      devMax = dev;
+      place = r+k;
+    }
+  }
+
+  iso = isoLevel(t, place);
+  place -= BEAT_TPL_PRE;
+  for(i = 0; i < BEAT_TPL_LEN; i++)
+    t->sum[i] += HIST(t, place+i) - iso;
+  t->num++;
+}
+
+static int16 isoLevel(BeatTpl_t *t, uint16 r)
+{
+  uint8 i;
+  int32 sum = 0;
+
+  r -= BEAT_TPL_ISO_OFS+3;
+  for(i = 0; i < 4; i++)
+    sum += HIST(t, r+i);
+  return (int16)(sum >> 2);
+}
+
+static int16 tplAt(BeatTpl_t *t, uint8 i)
+{
+  if(t->num == 0) return 0;
+  return (int16)(t->sum[i] / t->num);
+}
+
+static int16 tplSlope(BeatTpl_t *t, uint8 i)
+{
+  return tplAt(t, i+1) - tplAt(t, i-1);
+}
@@ -0,0 +1,58 @@
+/*
+ * BeatTpl.h : averaged beat template and its morphology
+ *
+ * The ecg is kept at BEAT_TPL_RATE in a short history. At each beat, the window of BEAT_TPL_LEN
+ * samples around the R peak is taken from the history once the samples after the peak have come,
+ * and added to the sums with its PR level removed. The R peak is the largest deviation from the
+ * PR level near the place given by the detector delay, so the beats are aligned on it.
+ * The template is the mean of the beats added since it was cleared.
+ *
+ * Morphology of the template, in the ecg unit from the PR level:
+ *   R amplitude : at the R peak
+ *   QRS width   : ms from the onset to the offset, where the slope falls below 1/8 of its max
+ *   ST level    : BEAT_TPL_ST_OFS after the QRS offset
+ *
+ * Packed template, little-endian, in BEAT_TPL_PACK_NUM packets:
+ *   packet 0   : 0, beat number(uint16), R amplitude(int16), QRS width(uint8 ms), ST level(int16),
+ *                BEAT_TPL_RATE, BEAT_TPL_PRE, BEAT_TPL_LEN
+ *   packet k   : k, up to BEAT_TPL_PACK_SAMPLES samples(int16) from the sample (k-1)*BEAT_TPL_PACK_SAMPLES
+ */
+
+#ifndef BEAT_TPL_H
+#define BEAT_TPL_H
+
+#include "hal_types.h"
+
+#define BEAT_TPL_RATE         125  // Hz, rate of the template
+#define BEAT_TPL_PRE          32   // samples before the R peak, 256ms
+#define BEAT_TPL_POST         48   // samples from the R peak, 384ms
+#define BEAT_TPL_LEN          (BEAT_TPL_PRE+BEAT_TPL_POST)
+#define BEAT_TPL_ALIGN        4    // the R peak is searched this number of samples around the detector place
+#define BEAT_TPL_HIST_LEN     128  // history length, must be a power of 2 and hold the window and the detector delay
+#define BEAT_TPL_MAX_NUM      1024 // the beats after this number are not added
+#define BEAT_TPL_PACK_SAMPLES 9    // samples per packet
+#define BEAT_TPL_PACK_NUM     (1+(BEAT_TPL_LEN+BEAT_TPL_PACK_SAMPLES-1)/BEAT_TPL_PACK_SAMPLES)
+#define BEAT_TPL_PACK_MAX_LEN (1+BEAT_TPL_PACK_SAMPLES*2)
+
+typedef struct
+{
+  uint8 decim;                    // input samples per template sample
+  uint8 decimNum;                 // input samples summed for the next history sample
+  int32 decimAcc;
+  int16 hist[BEAT_TPL_HIST_LEN];  // history at BEAT_TPL_RATE
+  uint16 histNum;                 // samples put into the history, wrapped
+  bool pending;                   // is a beat waiting for the samples after its R peak
+  uint16 rPos;                    // the history place of the pending R peak
+  bool hold;                      // the sums are held, the beats are dropped
+  uint16 num;                     // the number of beats in the sums
+  int32 sum[BEAT_TPL_LEN];
+} BeatTpl_t;
+
+extern void BeatTpl_Init(BeatTpl_t *t, uint16 sampleRate); // restart
+extern void BeatTpl_Clear(BeatTpl_t *t); // clear the sums
+extern void BeatTpl_Hold(BeatTpl_t *t, bool hold); // hold the sums, e.g. while the template is sent
+extern void BeatTpl_AddSample(BeatTpl_t *t, int16 x); // add an ecg sample
+extern void BeatTpl_AddBeat(BeatTpl_t *t, uint16 delay); // add a beat found delay samples after its R peak
+extern uint8 BeatTpl_Pack(BeatTpl_t *t, uint8 k, uint8 *pBuf); // pack the packet k, return the length
+
+#endif
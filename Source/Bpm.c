@@ -0,0 +1,36 @@
+/*
+ * Bpm.c : heart rate of a RR interval without a division
+ */
+
+#include "Bpm.h"
+
+// the longest RR interval for the bpm b at BPM_RATE, worked out by the compiler
+#define BPM_RR(b)       ((uint16)((60L*BPM_RATE)/(b)))
+#define BPM_RR4(b)      BPM_RR(b), BPM_RR((b)+1), BPM_RR((b)+2), BPM_RR((b)+3)
+#define BPM_RR16(b)     BPM_RR4(b), BPM_RR4((b)+4), BPM_RR4((b)+8), BPM_RR4((b)+12)
+#define BPM_RR64(b)     BPM_RR16(b), BPM_RR16((b)+16), BPM_RR16((b)+32), BPM_RR16((b)+48)
+
+// the entry of the bpm b is at index b-1, the last entry, for 256 bpm, is not used
+static const uint16 bpmRR[BPM_MAX+1] =
+{
+  BPM_RR64(1), BPM_RR64(65), BPM_RR64(129), BPM_RR64(193)
+};
+
+extern uint8 Bpm_FromRR(uint16 rr, uint16 sampleRate)
+{
+  uint8 shift = 0;
+  uint8 lo = 0, hi = BPM_MAX, mid;
+  
+  while(shift < 8 && (sampleRate << shift) < BPM_RATE)
+    shift++;
+  
+  while(lo < hi)
+  {
+    mid = (uint8)(((uint16)lo+hi+1)>>1);
+    if(rr <= (bpmRR[mid-1] >> shift))
+      lo = mid;
+    else
+      hi = mid-1;
+  }
+  return lo;
+}
@@ -0,0 +1,21 @@
+/*
+ * Bpm.h : heart rate of a RR interval without a division
+ *
+ * The bpm is 60*sampleRate/RR, limited to 255. The table holds the longest RR interval
+ * for each bpm at BPM_RATE, so the bpm is the number of the entries the RR interval is not
+ * longer than, found by a binary search. At BPM_RATE/2^k the entries are shifted right by k,
+ * which is exact as floor(floor(x/b)/2^k) == floor(x/(b*2^k)).
+ */
+
+#ifndef BPM_H
+#define BPM_H
+
+#include "hal_types.h"
+
+#define BPM_RATE            250  // Hz, the sample rate of the table
+#define BPM_MAX             255
+
+// the bpm of the RR interval rr in samples at sampleRate, which is BPM_RATE/2^k
+extern uint8 Bpm_FromRR(uint16 rr, uint16 sampleRate);
+
+#endif
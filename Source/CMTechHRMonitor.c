@@ -35,14 +35,22 @@
 #include "service_battery.h"
 #include "service_ecg.h"
 #include "App_HRFunc.h"
+#if defined(ECG_LOG)
+#include "Service_EcgLog.h"
+#include "EcgLog.h"
+#endif
 #include "Dev_ADS1x9x.H"
 #include "CMUtil.h"
+#if defined(ENERGY_PROFILE)
+#include "Energy.h"
+#endif
 
 #define ADVERTISING_INTERVAL 320 // ad interval, units of 0.625ms
 #define ADVERTISING_DURATION 2000 // ad duration, units of ms
 #define ADVERTISING_OFFTIME 8000 // ad offtime to wait for a next ad, units of ms
 
 #define NVID_WORK_MODE 0x80      // the NVID of the work mode
+#define NVID_LOG_ENABLED 0x81    // the NVID of the offline log enabled flag
 #define MODE_HR 0x00    // HR work mode
 #define MODE_ECG 0x01   // ECG work mode
 
@@ -60,19 +68,67 @@
 
 #define CONN_PAUSE_PERIPHERAL 4  // the pause time from the connection establishment to the update of the connection parameters
 
+// the connection interval controller, used while the ecg packets are notified in the ECG mode
+// it starts from the ECG mode parameters, watches the ecg packet queue each period, and goes one level
+// faster when the queue got full, or one level slower after CONN_CTRL_RELAX_NUM quiet periods if the
+// packets fit in the slower interval.
+// the HR mode is intentionally fixed on its own parameters: the HR notification is once a second
+// and the 125Hz ecg packets fit in its interval, so the controller is not run there
+#define CONN_CTRL_PERIOD 5000L // controller period, ms
+#define CONN_CTRL_RELAX_NUM 3 // quiet periods before going slower
+#define CONN_CTRL_FIT_PACKETS 2 // max packets per connection interval at the slower level
+#define CONN_LEVEL_NUM 5 // the number of controller levels
+
 #define INVALID_CONNHANDLE 0xFFFF // invalid connection handle
 #define STATUS_ECG_STOP 0x00     // ecg sampling stopped status
 #define STATUS_ECG_START 0x01    // ecg sampling started status
 
 #define HR_NOTI_PERIOD 2000 // heart rate notification period, ms
+#define HRV_NOTI_NUM 5 // heart rate variability notified once per HRV_NOTI_NUM heart rate notifications
+#define TPL_NOTI_NUM 15 // beat template notified once per TPL_NOTI_NUM heart rate notifications, only with ECG_TPL
 #define BATT_NOTI_PERIOD 120000L // battery notification period, ms
-#define ECG_1MV_CALI_VALUE  160  //164  // ecg 1mV calibration value
 
 static uint8 taskID;   
 static uint16 gapConnHandle = INVALID_CONNHANDLE;
 static gaprole_States_t gapProfileState = GAPROLE_INIT;
 static uint8 attDeviceName[GAP_DEVICE_NAME_LEN] = "KM HRM"; // GGS device name
 static uint8 status = STATUS_ECG_STOP; // ecg sampling status
+static uint8 hrvNotiNum = 0; // the heart rate notifications since the heart rate variability was notified
+#if defined(ECG_TPL)
+static uint8 tplNotiNum = 0; // the heart rate notifications since the beat template was notified
+#endif
+
+// connection parameters
+typedef struct
+{
+  uint16 minInterval; // units of 1.25ms
+  uint16 maxInterval; // units of 1.25ms
+  uint16 latency;
+  uint16 timeout; // units of 10ms
+} connParam_t;
+
+// connection parameters in the HR and ECG modes
+static const connParam_t hrModeParam = 
+  { HR_MODE_MIN_INTERVAL, HR_MODE_MAX_INTERVAL, HR_MODE_SLAVE_LATENCY, HR_MODE_CONNECT_TIMEOUT };
+static const connParam_t ecgModeParam = 
+  { ECG_MODE_MIN_INTERVAL, ECG_MODE_MAX_INTERVAL, ECG_MODE_SLAVE_LATENCY, ECG_MODE_CONNECT_TIMEOUT };
+
+// controller levels from the fastest, they meet the ios requirements noted in setParameter(),
+// and the timeout is more than 2*(1+latency)*max_interval
+static const connParam_t connLevels[CONN_LEVEL_NUM] =
+{
+  { ECG_MODE_MIN_INTERVAL, ECG_MODE_MAX_INTERVAL, ECG_MODE_SLAVE_LATENCY, ECG_MODE_CONNECT_TIMEOUT }, // 20-40ms, the ECG mode
+  { 32, 48, 4, 100 },   // 40-60ms
+  { 48, 64, 4, 200 },   // 60-80ms
+  { 80, 96, 4, 300 },   // 100-120ms
+  { 144, 160, 4, 600 }  // 180-200ms
+};
+static bool connCtrl = FALSE; // is the controller requested, it only runs in the ECG mode
+static uint8 connLevel = 0; // the current controller level
+static uint8 connQuiet = 0; // the number of quiet periods at the current level
+#if defined(ECG_LOG)
+static uint8 logEnabled = FALSE; // is the ecg logged when disconnected
+#endif
 
 uint16 SAMPLERATE; // ecg sample rate
 
@@ -106,6 +162,9 @@ static void gapStateCB( gaprole_States_t newState ); // gap state callback funct
 static void hrServiceCB( uint8 event ); // heart rate service callback function
 static void battServiceCB( uint8 event ); // battery service callback function
 static void ecgServiceCB( uint8 event ); // ecg service callback function
+#if defined(ECG_LOG)
+static void ecgLogServiceCB( uint8 event ); // ecg log service callback function
+#endif
 
 // GAP Role callback struct
 static gapRolesCBs_t gapStateCBs =
@@ -138,11 +197,26 @@ static ECGServiceCBs_t ecgServCBs =
   ecgServiceCB    
 };
 
+#if defined(ECG_LOG)
+// ecg log service callback struct
+static ECGLogServiceCBs_t ecgLogServCBs =
+{
+  ecgLogServiceCB    
+};
+#endif
+
+static uint16 processEvent( uint16 events ); // process one of the events, return the events left
+#if defined(ENERGY_PROFILE)
+static uint8 eventSubsystem( uint16 event ); // the energy profiling subsystem of an event
+#endif
 static void processOSALMsg( osal_event_hdr_t *pMsg ); // OSAL message process function
 static void initIOPin(); // initialize IO pins
 static void startEcgSampling( void ); // start ecg sampling
 static void stopEcgSampling( void ); // stop ecg sampling
 static void setParameter(uint8 mode);
+static void setConnParameter(const connParam_t* pParam); // set the connection parameters and update the connection
+static void startConnCtrl(bool start); // start or stop the connection interval controller
+static void runConnCtrl(void); // one period of the connection interval controller
 
 extern void HRM_Init( uint8 task_id )
 { 
@@ -212,6 +286,17 @@ extern void HRM_Init( uint8 task_id )
   ECG_AddService(GATT_ALL_SERVICES); // ecg service
   ECG_RegisterAppCBs( &ecgServCBs );  
   
+#if defined(ECG_LOG)
+  ECGLog_AddService(GATT_ALL_SERVICES); // ecg log service
+  ECGLog_RegisterAppCBs( &ecgLogServCBs );
+  
+  // find the log in the flash and read if it is enabled from NV
+  EcgLog_Init();
+  if(osal_snv_read(NVID_LOG_ENABLED, sizeof(uint8), &logEnabled) != SUCCESS)
+    logEnabled = FALSE;
+  ECGLog_SetParameter( ECGLOG_ENABLED, sizeof ( uint8 ), &logEnabled );
+#endif
+  
   // set characteristic in heart rate service
   {
     uint8 sensLoc = HRM_SENS_LOC_CHEST;
@@ -233,6 +318,9 @@ extern void HRM_Init( uint8 task_id )
   initIOPin();
   
   HRFunc_Init(taskID);
+#if defined(ENERGY_PROFILE)
+  Energy_Init();
+#endif
   
   HCI_EXT_ClkDivOnHaltCmd( HCI_EXT_ENABLE_CLK_DIVIDE_ON_HALT );  
 
@@ -243,30 +331,98 @@ extern void HRM_Init( uint8 task_id )
 static void setParameter(uint8 mode) 
 {
     // set the connection parameter according to the ecg lock status
-    uint16 desired_min_interval; // units of 1.25ms, Note: the ios device require min_interval>=20ms, max_interval>=min_interval+20
-    uint16 desired_max_interval; // units of 1.25ms, Note: the ios device require max_interval*(1+latency)<=2s
-    uint16 desired_slave_latency; // Note: the ios device require the slave latency <=4
-    uint16 desired_conn_timeout; // units of 10ms, Note: the ios device require the timeout <= 6s
-    if(mode == MODE_HR)
-    {
-      desired_min_interval = HR_MODE_MIN_INTERVAL;
-      desired_max_interval = HR_MODE_MAX_INTERVAL;
-      desired_slave_latency = HR_MODE_SLAVE_LATENCY;
-      desired_conn_timeout = HR_MODE_CONNECT_TIMEOUT;
-      SAMPLERATE = HR_MODE_SAMPLERATE;
-    }
+    // Note: the ios device require min_interval>=20ms, max_interval>=min_interval+20
+    // the ios device require max_interval*(1+latency)<=2s
+    // the ios device require the slave latency <=4
+    // the ios device require the timeout <= 6s
+    SAMPLERATE = (mode == MODE_HR) ? HR_MODE_SAMPLERATE : ECG_MODE_SAMPLERATE;
+    
+    // the controller starts again from the parameters of the new mode,
+    // only one update is sent
+    if(connCtrl)
+      startConnCtrl(TRUE);
     else
-    {
-      desired_min_interval = ECG_MODE_MIN_INTERVAL;
-      desired_max_interval = ECG_MODE_MAX_INTERVAL;
-      desired_slave_latency = ECG_MODE_SLAVE_LATENCY;
-      desired_conn_timeout = ECG_MODE_CONNECT_TIMEOUT;  
-      SAMPLERATE = ECG_MODE_SAMPLERATE;
-    }
+      setConnParameter((mode == MODE_HR) ? &hrModeParam : &ecgModeParam);
+}
+
+static void setConnParameter(const connParam_t* pParam)
+{
+    uint16 desired_min_interval = pParam->minInterval; // units of 1.25ms
+    uint16 desired_max_interval = pParam->maxInterval; // units of 1.25ms
+    uint16 desired_slave_latency = pParam->latency;
+    uint16 desired_conn_timeout = pParam->timeout; // units of 10ms
     GAPRole_SetParameter( GAPROLE_MIN_CONN_INTERVAL, sizeof( uint16 ), &desired_min_interval );
     GAPRole_SetParameter( GAPROLE_MAX_CONN_INTERVAL, sizeof( uint16 ), &desired_max_interval );
     GAPRole_SetParameter( GAPROLE_SLAVE_LATENCY, sizeof( uint16 ), &desired_slave_latency );
     GAPRole_SetParameter( GAPROLE_TIMEOUT_MULTIPLIER, sizeof( uint16 ), &desired_conn_timeout );  
+    
+    // switch the connection in place, the link is kept if the central rejects the update
+    if(gapProfileState == GAPROLE_CONNECTED)
+    {
+      GAPRole_SendUpdateParam( desired_min_interval, desired_max_interval, 
+                               desired_slave_latency, desired_conn_timeout, GAPROLE_NO_ACTION );
+    }
+}
+
+// start the controller from the ECG mode parameters, or stop it and go back to the parameters of the mode,
+// the controller is not run in the HR mode
+static void startConnCtrl(bool start)
+{
+  uint8 mode;
+  HRFunc_EcgLoad_t load;
+  
+  connCtrl = start;
+  ECG_GetParameter( ECG_WORK_MODE, &mode );
+  if(start && mode == MODE_ECG)
+  {
+    connLevel = 0;
+    connQuiet = 0;
+    HRFunc_GetEcgLoad(&load); // clear the load counted before
+    setConnParameter(&connLevels[0]);
+    osal_start_timerEx( taskID, HRM_CONN_CTRL_EVT, CONN_CTRL_PERIOD );
+  }
+  else
+  {
+    osal_stop_timerEx( taskID, HRM_CONN_CTRL_EVT );
+    setConnParameter((mode == MODE_HR) ? &hrModeParam : &ecgModeParam);
+  }
+}
+
+static void runConnCtrl(void)
+{
+  HRFunc_EcgLoad_t load;
+  uint32 fit;
+  
+  HRFunc_GetEcgLoad(&load);
+  
+  if(load.full || load.dropped != 0)
+  {
+    // the packets pile up, go faster
+    connQuiet = 0;
+    if(connLevel > 0)
+    {
+      connLevel--;
+      setConnParameter(&connLevels[connLevel]);
+    }
+  }
+  else if(load.maxQueued <= 1 && load.busy == 0)
+  {
+    // the packets queued in a slower interval: queued/period * max_interval*1.25
+    if(connLevel < CONN_LEVEL_NUM-1 && ++connQuiet >= CONN_CTRL_RELAX_NUM)
+    {
+      connQuiet = 0;
+      fit = (uint32)load.queued * connLevels[connLevel+1].maxInterval * 5;
+      if(fit <= (uint32)CONN_CTRL_FIT_PACKETS * CONN_CTRL_PERIOD * 4)
+      {
+        connLevel++;
+        setConnParameter(&connLevels[connLevel]);
+      }
+    }
+  }
+  else
+  {
+    connQuiet = 0;
+  }
 }
 
 // ʼIOܽ
@@ -290,6 +446,31 @@ static void initIOPin()
 extern uint16 HRM_ProcessEvent( uint8 task_id, uint16 events )
 {
   VOID task_id; // OSAL required parameter that isn't used in this function
+#if defined(ENERGY_PROFILE)
+  // the active time of the event processed is charged to its subsystem
+  Energy_Mark_t mark;
+  uint16 left;
+  
+  Energy_Begin(&mark);
+  left = processEvent(events);
+  Energy_End(eventSubsystem(events ^ left), &mark);
+  return left;
+#else
+  return processEvent(events);
+#endif
+}
+
+#if defined(ENERGY_PROFILE)
+static uint8 eventSubsystem( uint16 event )
+{
+  if(event & HRM_ECG_DATA_EVT) return ENERGY_ECG;
+  if(event & (HRM_HR_PERIODIC_EVT | HRM_ECG_NOTI_EVT | HRM_LOG_NOTI_EVT | HRM_TPL_NOTI_EVT)) return ENERGY_NOTI;
+  return ENERGY_TASK;
+}
+#endif
+
+static uint16 processEvent( uint16 events )
+{
   uint8 mode;
 
   if ( events & SYS_EVENT_MSG )
@@ -324,6 +505,22 @@ extern uint16 HRM_ProcessEvent( uint8 task_id, uint16 events )
     if(gapProfileState == GAPROLE_CONNECTED)
     {
       HRFunc_SendHRPacket(gapConnHandle);
+      HRFunc_SendSqiPacket(gapConnHandle);
+      if(++hrvNotiNum >= HRV_NOTI_NUM)
+      {
+        hrvNotiNum = 0;
+        HRFunc_SendHrvPacket(gapConnHandle);
+#if defined(ECG_RESP)
+        HRFunc_SendRespPacket(gapConnHandle);
+#endif
+      }
+#if defined(ECG_TPL)
+      if(++tplNotiNum >= TPL_NOTI_NUM)
+      {
+        tplNotiNum = 0;
+        HRFunc_StartTplSending();
+      }
+#endif
       osal_start_timerEx( taskID, HRM_HR_PERIODIC_EVT, HR_NOTI_PERIOD );
     }      
 
@@ -341,6 +538,27 @@ extern uint16 HRM_ProcessEvent( uint8 task_id, uint16 events )
     return (events ^ HRM_BATT_PERIODIC_EVT);
   }
   
+  if ( events & HRM_ECG_DATA_EVT )
+  {
+    HRFunc_ProcessEcgData();
+
+    return (events ^ HRM_ECG_DATA_EVT);
+  }
+  
+  if ( events & HRM_ADS_CTRL_EVT )
+  {
+    HRFunc_ProcessAdsCtrl();
+
+    return (events ^ HRM_ADS_CTRL_EVT);
+  }
+  
+  if ( events & HRM_LOFF_POLL_EVT )
+  {
+    HRFunc_ProcessLeadOffPoll();
+
+    return (events ^ HRM_LOFF_POLL_EVT);
+  }
+  
   if ( events & HRM_ECG_NOTI_EVT )
   {
     if (gapProfileState == GAPROLE_CONNECTED)
@@ -351,6 +569,41 @@ extern uint16 HRM_ProcessEvent( uint8 task_id, uint16 events )
     return (events ^ HRM_ECG_NOTI_EVT);
   } 
   
+#if defined(ECG_TPL)
+  if ( events & HRM_TPL_NOTI_EVT )
+  {
+    if (gapProfileState == GAPROLE_CONNECTED)
+    {
+      HRFunc_SendTplPackets(gapConnHandle);
+    }
+
+    return (events ^ HRM_TPL_NOTI_EVT);
+  } 
+#endif
+  
+#if defined(ECG_LOG)
+  if ( events & HRM_LOG_NOTI_EVT )
+  {
+    if (gapProfileState == GAPROLE_CONNECTED)
+    {
+      HRFunc_SendLogRecords(gapConnHandle);
+    }
+
+    return (events ^ HRM_LOG_NOTI_EVT);
+  } 
+#endif
+  
+  if ( events & HRM_CONN_CTRL_EVT )
+  {
+    if (gapProfileState == GAPROLE_CONNECTED && connCtrl)
+    {
+      runConnCtrl();
+      osal_start_timerEx( taskID, HRM_CONN_CTRL_EVT, CONN_CTRL_PERIOD );
+    }
+
+    return (events ^ HRM_CONN_CTRL_EVT);
+  }
+  
   if ( events & HRM_MODE_CHANGED_EVT )
   {
     if (gapProfileState == GAPROLE_CONNECTED)
@@ -358,7 +611,7 @@ extern uint16 HRM_ProcessEvent( uint8 task_id, uint16 events )
       ECG_GetParameter(ECG_WORK_MODE, &mode);
       setParameter(mode);      
       ECG_SetParameter( ECG_SAMPLE_RATE, sizeof ( uint16 ), &SAMPLERATE );
-      GAPRole_TerminateConnection();
+      HRFunc_SetSampleRate();
     }
 
     return (events ^ HRM_MODE_CHANGED_EVT);
@@ -386,11 +639,13 @@ static void gapStateCB( gaprole_States_t newState )
     // Get connection handle
     GAPRole_GetParameter( GAPROLE_CONNHANDLE, &gapConnHandle );
     
-    delayus(1000);
-    ADS1x9x_PowerUp(); 
-    delayus(1000);
-    ADS1x9x_StandBy();  
-    delayus(1000);
+#if defined(ECG_LOG)
+    // stop the offline log, the services start what they need
+    HRFunc_SetEcgLogging(false);
+    stopEcgSampling();
+    HRFunc_SetHRCalcing(false);
+#endif
+    HRFunc_SetEcgPower(true);
   }
   // disconnected
   else if(gapProfileState == GAPROLE_CONNECTED && 
@@ -401,8 +656,23 @@ static void gapStateCB( gaprole_States_t newState )
     HRFunc_SetEcgSending(false);
     VOID osal_stop_timerEx( taskID, HRM_HR_PERIODIC_EVT ); 
     VOID osal_stop_timerEx( taskID, HRM_BATT_PERIODIC_EVT );
+    // the next connection requests the parameters of the mode, not the last controller level.
+    // the state is set first, so no update is sent on the link that is gone
+    gapProfileState = newState;
+    startConnCtrl(FALSE);
     //initIOPin();
-    ADS1x9x_PowerDown();
+#if defined(ECG_LOG)
+    HRFunc_SetLogDownload(false);
+    if(logEnabled)
+    {
+      // keep sampling and log the ecg and RR until connected again
+      HRFunc_SetHRCalcing(true);
+      HRFunc_SetEcgLogging(true);
+      startEcgSampling();
+    }
+    else
+#endif
+    HRFunc_SetEcgPower(false);
   }
   // if started
   else if (newState == GAPROLE_STARTED)
@@ -496,10 +766,12 @@ static void ecgServiceCB( uint8 event )
   {
     case ECG_PACK_NOTI_ENABLED:
       HRFunc_SetEcgSending(true);
+      startConnCtrl(TRUE);
       break;
         
     case ECG_PACK_NOTI_DISABLED:
       HRFunc_SetEcgSending(false);
+      startConnCtrl(FALSE);
       break;
       
     case ECG_WORK_MODE_CHANGED:
@@ -510,8 +782,48 @@ static void ecgServiceCB( uint8 event )
       }
       break;
       
+    case ECG_PACK_FORMAT_CHANGED:
+      ECG_GetParameter( ECG_PACK_FORMAT, &mode );
+      HRFunc_SetEcgPackFormat(mode);
+      break;
+      
     default:
       // Should not get here
       break;
   }
-}
\ No newline at end of file
+}
+
+#if defined(ECG_LOG)
+static void ecgLogServiceCB( uint8 event )
+{
+  uint8 cmd;
+  switch (event)
+  {
+    case ECGLOG_DATA_NOTI_DISABLED:
+      HRFunc_SetLogDownload(false);
+      break;
+      
+    case ECGLOG_CMD_RECEIVED:
+      ECGLog_GetParameter( ECGLOG_CTRL, &cmd );
+      if(cmd == ECGLOG_CMD_DISABLE || cmd == ECGLOG_CMD_ENABLE)
+      {
+        logEnabled = (cmd == ECGLOG_CMD_ENABLE);
+        osal_snv_write(NVID_LOG_ENABLED, sizeof(uint8), &logEnabled);
+        ECGLog_SetParameter( ECGLOG_ENABLED, sizeof ( uint8 ), &logEnabled );
+      }
+      else if(cmd == ECGLOG_CMD_DOWNLOAD)
+      {
+        HRFunc_SetLogDownload(true);
+      }
+      else if(cmd == ECGLOG_CMD_CLEAR)
+      {
+        HRFunc_SetLogDownload(false);
+        EcgLog_Clear();
+      }
+      break;
+      
+    default:
+      break;
+  }
+}
+#endif
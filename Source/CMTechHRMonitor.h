@@ -11,9 +11,16 @@
 #define HRM_BATT_PERIODIC_EVT 0x0004     // periodic battery measurement event
 #define HRM_ECG_NOTI_EVT 0x0008 // ecg packet notification event
 #define HRM_MODE_CHANGED_EVT 0x0010 //work mode changed event
+#define HRM_ECG_DATA_EVT 0x0020 // ecg samples ready in the sample ring buffer event
+#define HRM_ADS_CTRL_EVT 0x0040 // ADS1x9x control step event
+#define HRM_LOG_NOTI_EVT 0x0080 // log record notification event
+#define HRM_CONN_CTRL_EVT 0x0100 // connection interval controller period event
+#define HRM_LOFF_POLL_EVT 0x0200 // lead-off probe event
+#define HRM_TPL_NOTI_EVT 0x0400 // beat template notification event
 
 #define HR_MODE_SAMPLERATE 125 // sample rate in HR mode
 #define ECG_MODE_SAMPLERATE 250 // sample rate in ECG mode
+#define ECG_1MV_CALI_VALUE  160  //164  // ecg 1mV calibration value of the 16 bits samples
 
 extern uint16 SAMPLERATE; // ecg sample rate
 
@@ -1,6 +1,9 @@
 
 
 #include "CMUtil.h"
+#if defined(ENERGY_PROFILE)
+#include "Energy.h"
+#endif
 
 // ȡ16λUUID
 extern bStatus_t utilExtractUuid16(gattAttribute_t *pAttr, uint16 *pUuid)
@@ -28,6 +31,11 @@ extern bStatus_t utilExtractUuid16(gattAttribute_t *pAttr, uint16 *pUuid)
 //ʱus
 extern void delayus(uint16 us)
 {
+#if defined(ENERGY_PROFILE)
+  Energy_Mark_t mark;
+  Energy_Begin(&mark);
+#endif
+  
   while(us--)
   {
     /* 32 NOPs == 1 usecs */
@@ -39,6 +47,10 @@ extern void delayus(uint16 us)
     asm("nop"); asm("nop"); asm("nop"); asm("nop"); asm("nop");
     asm("nop"); asm("nop");
   }
+  
+#if defined(ENERGY_PROFILE)
+  Energy_End(ENERGY_DELAY, &mark);
+#endif
 }
 
 
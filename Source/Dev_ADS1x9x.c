@@ -3,6 +3,9 @@
 #include "hal_mcu.h"
 #include "CMUtil.h"
 #include "CMTechHRMonitor.h"
+#if defined(ENERGY_PROFILE)
+#include "Energy.h"
+#endif
     
 // all registers for outputing the test signal
 const static uint8 ECGRegs125[12] = {  
@@ -11,17 +14,17 @@ const static uint8 ECGRegs125[12] = {
   //CONFIG1
   0x00,                     //continous sample,125sps
   //CONFIG2
-  0xA0,                     //
+  0xE0,                     //lead-off comparators on
   //LOFF
-  0x10,                     //
+  0x10,                     //95% threshold, 6nA DC lead-off current
   //CH1SET 
   0x60,                     //PGA=12and ECG input
   //CH2SET
   0x80,                     //close CH2
   //RLD_SENS     
   0x23,                     //
-  //LOFF_SENS (default)
-  0x00,                     //disable channel 1 lead-off detect
+  //LOFF_SENS
+  0x03,                     //enable channel 1 lead-off detect
   //LOFF_STAT
   0x00,                     //default
   //RESP1
@@ -39,17 +42,17 @@ const static uint8 ECGRegs250[12] = {
   //CONFIG1
   0x01,                     //continous sample,250sps
   //CONFIG2
-  0xA0,                     //
+  0xE0,                     //lead-off comparators on
   //LOFF
-  0x10,                     //
+  0x10,                     //95% threshold, 6nA DC lead-off current
   //CH1SET 
   0x60,                     //PGA=12and ECG input
   //CH2SET
   0x80,                     //close CH2
   //RLD_SENS     
   0x23,                     //
-  //LOFF_SENS (default)
-  0x00,                     //disable channel 1 lead-off detect
+  //LOFF_SENS
+  0x03,                     //enable channel 1 lead-off detect
   //LOFF_STAT
   0x00,                     //default
   //RESP1
@@ -60,15 +63,63 @@ const static uint8 ECGRegs250[12] = {
   0x0C                      //
 };
 
+// frame read at each DRDY: the status word, the channel 1 word and, with the respiration,
+// the channel 2 word. A word is 3 bytes with the 24 bits chips and 2 bytes with the 16 bits ones
+#define ADS_WORD_LEN24 3
+#define ADS_WORD_LEN16 2
+#define ADS_FRAME_MAX_LEN (3*ADS_WORD_LEN24)
+
+#if defined(ECG_RESP)
+// the registers changed for the respiration on the ADS1x92R
+#define ADS_RESP_CH2SET 0x00 // PGA=6 and normal input
+#define ADS_RESP_RESP1  0xEA // demodulation and modulation on, phase 112.5 degrees
+#define ADS_RESP_RESP2  0x03 // 32kHz modulation, internal RLD reference
+#endif
+
 static ADS_DataCB_t pfnADSDataCB; // callback function processing data 
-//static uint8 data[2];
-//static int16 * pEcg = (int16*)data;
-static int ecgData;
+static int32 ecgData;
+static uint8 devId = ADS1x9x_DEVID_ADS1191; // DEVID read at power up
+static uint8 wordLen = ADS_WORD_LEN16; // word length of the chip
+static uint8 frameLen = 2*ADS_WORD_LEN16; // frame length read
+#if defined(ECG_RESP)
+static bool respOn = false; // is the respiration read on channel 2
+#endif
+
+#if defined(ADS_SPI_DMA)
+// the frame is read by DMA while the next sample is being converted
+// so the ISR only starts the DMA and delivers the frame read at the previous DRDY
+static uint8 frame[2][ADS_FRAME_MAX_LEN]; // double buffer read by DMA
+static uint8 frameIdx; // the buffer the DMA is reading into
+static bool frameValid; // a frame has been read since started
+static uint16 frameMissed; // DRDYs while the previous frame was still in progress
+static void readOneSampleByDMA(void); // start reading the frame, deliver the previous one
+#endif
+
+#if defined(ADS_ISR_PROFILE)
+#include "OSAL.h"
+
+extern uint32 halSleepReadTimer( void ); // in hal_sleep.c
+
+#define ST_TICK_MASK 0x00FFFFFFL // the sleep timer is 24 bits
+
+static ADS_IsrStat_t isrStat; // DRDY ISR statistics
+static uint32 isrDurSum; // sum of the ISR durations, us
+static uint32 isrLastEntry; // sleep timer at the last ISR entry
+static bool isrFirst; // is it the first ISR since started
+static uint16 isrJitterTicks; // max period deviation, sleep timer ticks
+static uint16 isrEntry; // Timer 1 count at the ISR entry
+
+static void isrProfileStart(void); // start profiling with a new sample period
+static void isrProfileEnter(void); // timestamp the ISR entry
+static void isrProfileExit(void); // timestamp the ISR exit and update the statistics
+#endif
 
 static void execute(uint8 cmd); // execute command
 static void setRegsAsNormalECGSignal(uint16 sampleRate); // set registers as outputing normal ECG signal
-//static void readOneSampleUsingADS1291(void); // read one data with ADS1291
-static void readOneSampleUsingADS1191(void); // read one data with ADS1191
+static void readOneSample(void); // read one data
+static int32 frameData(const uint8 *pFrame, uint8 ch); // the data of channel ch+1 in a frame
+static void deliverFrame(const uint8 *pFrame); // deliver a frame to the callback
+static uint8 frameLeadOff(const uint8 *pFrame); // the LOFF_STAT in a frame
 
 // ADS init
 extern void ADS1x9x_Init(ADS_DataCB_t pfnADS_DataCB_t)
@@ -78,13 +129,17 @@ extern void ADS1x9x_Init(ADS_DataCB_t pfnADS_DataCB_t)
   // init ADS1x9x chip
   SPI_ADS_Init();
   
+#if defined(ADS_ISR_PROFILE)
+  T1CTL = 0x09; // Timer 1 free running at tick/32, that is 1us per count
+  ADS1x9x_ResetIsrStat();
+#endif
+  
   ADS1x9x_PowerDown(); 
 }
 
 extern void ADS1x9x_PowerDown()
 {
   ADS_RST_LOW();     //PWDN/RESET ͵ƽ
-  delayus(10000);
 }
 
 // wakeup
@@ -107,9 +162,44 @@ extern void ADS1x9x_PowerUp(void)
   ADS_RST_HIGH();    //PWDN/RESET ߵƽ
   delayus(50);
   
+  // the same firmware runs with either chip, the data length follows the DEVID
+  devId = ADS1x9x_ReadRegister(ADS1x9x_REG_DEVID);
+  // a DEVID out of the family, as 0x00 or 0xFF when the SPI read fails, is not trusted
+  // for the frame length: fall back to the baseline ADS1191, 16 bits and one channel
+  if((devId & ADS1x9x_DEVID_FAMILY_MASK) != ADS1x9x_DEVID_FAMILY)
+    devId = ADS1x9x_DEVID_ADS1191;
+  wordLen = (devId & ADS1x9x_DEVID_RES24) ? ADS_WORD_LEN24 : ADS_WORD_LEN16;
+  frameLen = 2*wordLen;
+  
   setRegsAsNormalECGSignal(SAMPLERATE);
+  
+#if defined(ECG_RESP)
+  // the respiration is measured on channel 2 of the two channels chips
+  respOn = ((devId & ADS1x9x_DEVID_2CH) != 0);
+  if(respOn)
+  {
+    ADS1x9x_WriteRegister(ADS1x9x_REG_CH2SET, ADS_RESP_CH2SET);
+    ADS1x9x_WriteRegister(ADS1x9x_REG_RESP1, ADS_RESP_RESP1);
+    ADS1x9x_WriteRegister(ADS1x9x_REG_RESP2, ADS_RESP_RESP2);
+    frameLen = 3*wordLen;
+  }
+#endif
+}
+
+// is the chip a 24 bits one
+extern bool ADS1x9x_Is24Bit(void)
+{
+  return (wordLen == ADS_WORD_LEN24);
 }
 
+#if defined(ECG_RESP)
+// is the respiration read on channel 2
+extern bool ADS1x9x_HasResp(void)
+{
+  return respOn;
+}
+#endif
+
 // start continuous sampling
 extern void ADS1x9x_StartConvert(void)
 {
@@ -122,16 +212,28 @@ extern void ADS1x9x_StartConvert(void)
   delayus(100);
   //ADS_CS_HIGH();  
   
+#if defined(ADS_SPI_DMA)
+  frameIdx = 0;
+  frameValid = false;
+  frameMissed = 0;
+#endif
+#if defined(ADS_ISR_PROFILE)
+  // the first period after a start is not a sample period
+  isrProfileStart();
+#endif
+  
   delayus(100);   
   
   //START ߵƽ
   ADS_START_HIGH();    
-  delayus(32000); 
 }
 
 // stop continuous sampling
 extern void ADS1x9x_StopConvert(void)
 {
+#if defined(ADS_SPI_DMA)
+  SPI_ADS_WaitFrameDMA();
+#endif
   //ADS_CS_LOW();  
   delayus(100);
   SPI_ADS_SendByte(SDATAC);
@@ -244,79 +346,219 @@ static void execute(uint8 cmd)
 #pragma vector = P0INT_VECTOR
 __interrupt void PORT0_ISR(void)
 { 
+#if defined(ENERGY_PROFILE)
+  Energy_Mark_t mark;
+#endif
+  
   HAL_ENTER_ISR();  // Hold off interrupts.
   
+#if defined(ENERGY_PROFILE)
+  Energy_Begin(&mark);
+#endif
+#if defined(ADS_ISR_PROFILE)
+  isrProfileEnter();
+#endif
+  
   //if(P0IFG & 0x02)  //P0_1ж
   //{
     P0IFG &= 0xFD; //~(1<<1);   //clear P0_1 IFG 
     P0IF = 0;   //clear P0 interrupt flag
 
-#if defined(ADS1291)    
-    readOneSampleUsingADS1291();
-#elif defined(ADS1191)
-    readOneSampleUsingADS1191();
+#if defined(ADS_SPI_DMA)
+    readOneSampleByDMA();
+#else
+    readOneSample();
 #endif
   //}
   
+#if defined(ADS_ISR_PROFILE)
+  isrProfileExit();
+#endif
+#if defined(ENERGY_PROFILE)
+  Energy_End(ENERGY_ISR, &mark);
+#endif
+  
   HAL_EXIT_ISR();   // Re-enable interrupts.  
 }
 
+// read the frame byte by byte
 // ADS1291: high precise(24bits) chip with only one channel
-/*
-static void readOneSampleUsingADS1291(void)
+// ADS1191: low precise(16bits) chip with only one channel
+static void readOneSample(void)
 {  
-  ADS_CS_LOW();
-  uint8 data[3]; // received channel 1 data buffer
+  uint8 data[ADS_FRAME_MAX_LEN]; // received frame
+  uint8 i;
+  
+  for(i = 0; i < frameLen; i++)
+  {
+    SPI_SEND(ADS_DUMMY_CHAR); 
+    while (!U1TX_BYTE);
+    U1TX_BYTE = 0;
+    data[i] = U1DBUF;
+  }
+   
+  deliverFrame(data);
+}
+
+static void deliverFrame(const uint8 *pFrame)
+{
+#if defined(ECG_RESP)
+  pfnADSDataCB(frameData(pFrame, 0), respOn ? frameData(pFrame, 1) : 0, frameLeadOff(pFrame));
+#else
+  pfnADSDataCB(frameData(pFrame, 0), 0, frameLeadOff(pFrame));
+#endif
+}
+
+// the channel data follows the status word, MSB first
+// the data is sign extended in 24 bits full scale
+static int32 frameData(const uint8 *pFrame, uint8 ch)
+{
+  pFrame += (ch+1)*wordLen;
+  *((uint8*)&ecgData+3) = ((pFrame[0] & 0x80) ? 0xFF : 0x00);
+  *((uint8*)&ecgData+2) = pFrame[0];   //MSB
+  *((uint8*)&ecgData+1) = pFrame[1];
+  *((uint8*)&ecgData) = (wordLen == ADS_WORD_LEN24) ? pFrame[2] : 0x00;   //LSB
+  return ecgData;
+}
+
+// the status bytes begin with 1100, LOFF_STAT[4:0], GPIO[1:0] with both chips
+static uint8 frameLeadOff(const uint8 *pFrame)
+{
+  return (uint8)(((pFrame[0] & 0x0F) << 1) | (pFrame[1] >> 7));
+}
+
+#if defined(ADS_SPI_DMA)
+// start reading the new frame by DMA into one buffer and deliver the frame in the other one
+// the sample is delivered one sample period late, but the ISR does not wait for the SPI
+static void readOneSampleByDMA(void)
+{
+  uint8 *pDone;
   
-  SPI_ADS_SendByte(ADS_DUMMY_CHAR);
-  SPI_ADS_SendByte(ADS_DUMMY_CHAR);
-  SPI_ADS_SendByte(ADS_DUMMY_CHAR);  
+  if(SPI_ADS_FrameDMABusy())
+  {
+    // the SPI is still busy with the previous frame, skip this one
+    frameMissed++;
+    return;
+  }
   
-  data[2] = SPI_ADS_SendByte(ADS_DUMMY_CHAR);   //MSB
-  data[1] = SPI_ADS_SendByte(ADS_DUMMY_CHAR);
-  data[0] = SPI_ADS_SendByte(ADS_DUMMY_CHAR);   //LSB
+  pDone = frame[frameIdx];
+  frameIdx ^= 1;
+  SPI_ADS_ReadFrameDMA(frame[frameIdx], frameLen);
   
-  ADS_CS_HIGH();
+  if(frameValid)
+  {
+    deliverFrame(pDone);
+  }
+  frameValid = true;
+}
+#endif
+
+#if defined(ADS_ISR_PROFILE)
+// get the DRDY ISR statistics
+extern void ADS1x9x_GetIsrStat(ADS_IsrStat_t* pStat)
+{
+  uint32 sum;
+  uint16 jitter;
+  halIntState_t intState;
   
-  int16 ecg = (int16)((data[1] & 0x00FF) | ((data[2] & 0x00FF) << 8));
-   
-  pfnADSDataCB(ecg);
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  osal_memcpy(pStat, &isrStat, sizeof(ADS_IsrStat_t));
+  sum = isrDurSum;
+  jitter = isrJitterTicks;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+  
+  pStat->meanDur = (pStat->count == 0) ? 0 : (uint16)(sum/pStat->count);
+  pStat->maxJitter = (uint16)(((uint32)jitter*15625L)>>9); // one sleep timer tick = 1000000/32768 us = 15625/512 us
 }
-*/
 
-// ADS1191: low precise(16bits) chip with only one channel
-static void readOneSampleUsingADS1191(void)
-{  
-  //ADS_CS_LOW();
+// pack the DRDY ISR statistics in little endian, return the length
+extern uint8 ADS1x9x_PackIsrStat(uint8* pBuf)
+{
+  ADS_IsrStat_t stat;
+  uint16* pValue = (uint16*)&stat;
+  uint8 i;
+  
+  ADS1x9x_GetIsrStat(&stat);
+  for(i = 0; i < ADS_ISR_STAT_LEN/2; i++)
+  {
+    *pBuf++ = LO_UINT16(*pValue);
+    *pBuf++ = HI_UINT16(*pValue++);
+  }
+  return ADS_ISR_STAT_LEN;
+}
+
+// reset the DRDY ISR statistics
+extern void ADS1x9x_ResetIsrStat(void)
+{
+  halIntState_t intState;
   
-  //SPI_ADS_SendByte(ADS_DUMMY_CHAR);
-  //SPI_ADS_SendByte(ADS_DUMMY_CHAR);  
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  osal_memset(&isrStat, 0, sizeof(ADS_IsrStat_t));
+  isrStat.minDur = 0xFFFF;
+  isrDurSum = 0;
+  isrJitterTicks = 0;
+  isrFirst = true;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+// start profiling with a new sample period
+static void isrProfileStart(void)
+{
+  halIntState_t intState;
   
-  //data[1] = SPI_ADS_SendByte(ADS_DUMMY_CHAR);   //MSB
-  //data[0] = SPI_ADS_SendByte(ADS_DUMMY_CHAR);   //LSB
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  isrFirst = true;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+// timestamp the ISR entry
+static void isrProfileEnter(void)
+{
+  uint32 now = halSleepReadTimer();
   
-  //SPI_ADS_SendByte(ADS_DUMMY_CHAR);
-  //SPI_ADS_SendByte(ADS_DUMMY_CHAR);
+  // Note: read of T1CNTL latches T1CNTH
+  ((uint8*)&isrEntry)[0] = T1CNTL;
+  ((uint8*)&isrEntry)[1] = T1CNTH;
   
-  //ADS_CS_HIGH();
+  if(isrFirst)
+  {
+    isrFirst = false;
+  }
+  else
+  {
+    // deviation of the period from the sample period in sleep timer ticks
+    // a gap longer than 2 s saturates instead of wrapping
+    uint32 elapsed = (now - isrLastEntry) & ST_TICK_MASK;
+    uint16 period = (elapsed > 0xFFFF) ? 0xFFFF : (uint16)elapsed;
+    uint16 nominal = (uint16)(32768L/SAMPLERATE);
+    uint16 dev = (period > nominal) ? period-nominal : nominal-period;
+    if(dev > isrJitterTicks) isrJitterTicks = dev;
+  }
+  isrLastEntry = now;
+}
+
+// timestamp the ISR exit and update the statistics
+static void isrProfileExit(void)
+{
+  uint16 now;
+  uint16 dur;
+  uint16 t;
+  uint8 bin = 0;
   
-  SPI_SEND(ADS_DUMMY_CHAR); 
-  while (!U1TX_BYTE);
-  U1TX_BYTE = 0;
+  ((uint8*)&now)[0] = T1CNTL;
+  ((uint8*)&now)[1] = T1CNTH;
+  dur = now - isrEntry; // Timer 1 wraps at 16 bits, so does the subtraction
   
-  SPI_SEND(ADS_DUMMY_CHAR); 
-  while (!U1TX_BYTE);
-  U1TX_BYTE = 0;
+  if(isrStat.count == 0xFFFF) return; // saturated, reset to restart
   
-  SPI_SEND(ADS_DUMMY_CHAR); 
-  while (!U1TX_BYTE);
-  U1TX_BYTE = 0;
-  *((uint8*)&ecgData+1) = U1DBUF;
+  isrStat.count++;
+  isrDurSum += dur;
+  if(dur < isrStat.minDur) isrStat.minDur = dur;
+  if(dur > isrStat.maxDur) isrStat.maxDur = dur;
   
-  SPI_SEND(ADS_DUMMY_CHAR); 
-  while (!U1TX_BYTE);
-  U1TX_BYTE = 0;  
-  *((uint8*)&ecgData) = U1DBUF;  
-   
-  pfnADSDataCB(ecgData);
-}
\ No newline at end of file
+  // bin i holds the durations below 64us<<i, the last bin holds the rest
+  for(t = dur>>6; t != 0 && bin < ADS_ISR_HIST_NUM-1; t >>= 1)
+    bin++;
+  isrStat.hist[bin]++;
+}
+#endif
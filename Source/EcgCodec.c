@@ -0,0 +1,98 @@
+/*
+ * EcgCodec.c : lossless ecg packet coding, first difference + Rice code
+ */
+
+#include "EcgCodec.h"
+#include "OSAL.h"
+
+static void putBits(EcgRice_t *c, uint16 bits, uint8 len); // write the len low bits of bits, MSB first
+static void putOnes(EcgRice_t *c, uint8 len); // write len one bits
+
+extern void EcgRice_Init(EcgRice_t *c, uint8 maxLen)
+{
+  c->maxLen = maxLen;
+  c->k = ECG_RICE_K_INIT;
+  c->n = 0;
+}
+
+extern void EcgRice_Begin(EcgRice_t *c, uint8 *pPack, uint8 packNum, int16 first)
+{
+  osal_memset(pPack, 0, c->maxLen);
+  pPack[0] = packNum;
+  pPack[1] = c->k;
+  pPack[3] = LO_UINT16(first);
+  pPack[4] = HI_UINT16(first);
+
+  c->pPack = pPack;
+  c->bitNum = ECG_RICE_HEAD_LEN*8;
+  c->last = first;
+  c->n = 1;
+  c->uSum = 0;
+}
+
+extern bool EcgRice_Add(EcgRice_t *c, int16 x)
+{
+  int32 d = (int32)x - c->last;
+  uint32 u = (d >= 0) ? ((uint32)d << 1) : (((uint32)(-d) << 1) - 1);
+  uint32 q = u >> c->k;
+  uint8 len = (q < ECG_RICE_Q_ESC) ? (uint8)q + 1 + c->k : ECG_RICE_Q_ESC + 16;
+
+  if(c->n == 0xFF || c->bitNum + len > (uint16)c->maxLen*8)
+    return FALSE;
+
+  if(q < ECG_RICE_Q_ESC)
+  {
+    putOnes(c, (uint8)q);
+    putBits(c, 0, 1);
+    putBits(c, (uint16)u, c->k);
+  }
+  else
+  {
+    putOnes(c, ECG_RICE_Q_ESC);
+    putBits(c, (uint16)x, 16);
+  }
+
+  c->last = x;
+  c->n++;
+  c->uSum += u;
+  return TRUE;
+}
+
+extern uint8 EcgRice_End(EcgRice_t *c)
+{
+  uint8 k = 0;
+  uint16 num = c->n - 1; // the number of the differences
+
+  c->pPack[2] = c->n;
+
+  // the next k is about log2 of the mean difference, that suits the next packet
+  // as the ecg changes slowly between the packets
+  if(num != 0)
+  {
+    while(k < ECG_RICE_K_MAX && ((uint32)num << (k+1)) <= c->uSum)
+      k++;
+    c->k = k;
+  }
+
+  c->n = 0;
+  return (uint8)((c->bitNum + 7) >> 3);
+}
+
+static void putBits(EcgRice_t *c, uint16 bits, uint8 len)
+{
+  while(len--)
+  {
+    if(bits & ((uint16)1 << len))
+      c->pPack[c->bitNum >> 3] |= (0x80 >> (c->bitNum & 0x07));
+    c->bitNum++;
+  }
+}
+
+static void putOnes(EcgRice_t *c, uint8 len)
+{
+  while(len--)
+  {
+    c->pPack[c->bitNum >> 3] |= (0x80 >> (c->bitNum & 0x07));
+    c->bitNum++;
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ * EcgCodec.h : lossless ecg packet coding, first difference + Rice code
+ *
+ * Packet layout:
+ *   byte 0     : packet number
+ *   byte 1     : k, the Rice parameter of the packet
+ *   byte 2     : n, the number of samples in the packet
+ *   byte 3..4  : the first sample, int16, little-endian
+ *   byte 5..   : n-1 codes, bit-packed MSB first, the unused bits at the end are 0
+ *
+ * Each code is the difference d = x[i] - x[i-1] mapped to u = (d >= 0) ? 2d : -2d-1,
+ * written as q = u>>k one bits, a zero bit and the k low bits of u.
+ * If q >= ECG_RICE_Q_ESC, ECG_RICE_Q_ESC one bits are written and then x[i] itself in 16 bits.
+ * The first sample is sent as it is, so every packet can be decoded without the others.
+ */
+
+#ifndef ECG_CODEC_H
+#define ECG_CODEC_H
+
+#include "hal_types.h"
+
+#define ECG_RICE_HEAD_LEN   5  // packet header bytes
+#define ECG_RICE_K_INIT     4  // Rice parameter of the first packet
+#define ECG_RICE_K_MAX      12 // max Rice parameter
+#define ECG_RICE_Q_ESC      16 // unary quotient escaping to a raw sample
+
+typedef struct
+{
+  uint8 *pPack;   // the packet being coded
+  uint8 maxLen;   // max packet length in bytes
+  uint16 bitNum;  // the bits used in the packet, including the header
+  int16 last;     // the last sample coded
+  uint8 k;        // Rice parameter of the packet
+  uint8 n;        // the number of samples in the packet, 0 if no packet is open
+  uint32 uSum;    // sum of the mapped differences, to choose k for the next packet
+} EcgRice_t;
+
+extern void EcgRice_Init(EcgRice_t *c, uint8 maxLen); // init with the max packet length
+extern void EcgRice_Begin(EcgRice_t *c, uint8 *pPack, uint8 packNum, int16 first); // open a packet with the first sample
+extern bool EcgRice_Add(EcgRice_t *c, int16 x); // code a sample, FALSE if it does not fit in the packet
+extern uint8 EcgRice_End(EcgRice_t *c); // close the packet, return its length in bytes
+
+#endif
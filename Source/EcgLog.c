@@ -0,0 +1,165 @@
+/*
+ * EcgLog.c : offline ecg/RR log in a circular range of internal flash pages
+ */
+
+#include "EcgLog.h"
+#include "OSAL.h"
+#include "hal_flash.h"
+
+#if defined(ECG_LOG)
+
+#define LOG_PAGE(pg) ((uint8)(ECG_LOG_PAGE_BEG+(pg))) // flash page of the log page pg
+#define NEXT_PAGE(pg) (((pg) == ECG_LOG_PAGE_CNT-1) ? 0 : (pg)+1)
+#define PREV_PAGE(pg) (((pg) == 0) ? ECG_LOG_PAGE_CNT-1 : (pg)-1)
+
+typedef struct
+{
+  uint16 seq;     // page sequence number
+  uint16 magic;   // ECG_LOG_MAGIC
+  uint32 cleared; // 0 if the page was cleared
+} pageHead_t;
+
+static bool hasPage = FALSE; // is there a page written in the log
+static uint8 headPg = 0; // the page written last
+static uint16 headSeq = 0; // sequence number of the head page
+static bool headOpen = FALSE; // can records be appended to the head page
+static uint8 headRec = 0; // the next record in the head page
+static uint8 usedPages = 0; // the number of pages with records not cleared, up to the head page
+static uint16 readNum = 0; // the read position, counted from the oldest record
+
+static bool readHead(uint8 pg, pageHead_t *pHead); // read the page header, FALSE if not a log page
+static void writeFlash(uint8 pg, uint16 offset, uint8 *pBuf, uint16 len); // write len bytes, a multiple of the flash word
+static void openPage(void); // erase the next page and begin it
+
+extern void EcgLog_Init(void)
+{
+  pageHead_t head;
+  uint8 pg, k;
+  uint8 type;
+
+  hasPage = FALSE;
+  headOpen = FALSE;
+  usedPages = 0;
+  readNum = 0;
+
+  // the head page has the latest sequence number
+  for(pg = 0; pg < ECG_LOG_PAGE_CNT; pg++)
+  {
+    if(!readHead(pg, &head)) continue;
+    if(!hasPage || (int16)(head.seq - headSeq) > 0)
+    {
+      hasPage = TRUE;
+      headPg = pg;
+      headSeq = head.seq;
+    }
+  }
+  if(!hasPage) return;
+
+  // the pages before the head page in sequence and not cleared are in use
+  for(pg = headPg, k = 0; k < ECG_LOG_PAGE_CNT; pg = PREV_PAGE(pg), k++)
+  {
+    if(!readHead(pg, &head) || head.seq != (uint16)(headSeq-k) || head.cleared == 0) break;
+    usedPages++;
+  }
+  if(usedPages == 0) return;
+
+  // find the first erased record in the head page
+  headOpen = TRUE;
+  for(headRec = 0; headRec < ECG_LOG_REC_NUM; headRec++)
+  {
+    HalFlashRead(LOG_PAGE(headPg), ECG_LOG_HEAD_LEN + (uint16)headRec*ECG_LOG_REC_LEN, &type, 1);
+    if(type == ECG_LOG_REC_EMPTY) break;
+  }
+}
+
+extern void EcgLog_Append(const uint8 *pRec)
+{
+  static uint8 rec[ECG_LOG_REC_LEN]; // in XDATA for the flash DMA
+
+  if(!headOpen || headRec >= ECG_LOG_REC_NUM)
+    openPage();
+
+  osal_memcpy(rec, pRec, ECG_LOG_REC_LEN);
+  writeFlash(headPg, ECG_LOG_HEAD_LEN + (uint16)headRec*ECG_LOG_REC_LEN, rec, ECG_LOG_REC_LEN);
+  headRec++;
+}
+
+extern uint16 EcgLog_Count(void)
+{
+  if(usedPages == 0) return 0;
+  return (uint16)(usedPages-1)*ECG_LOG_REC_NUM + headRec;
+}
+
+extern void EcgLog_Rewind(void)
+{
+  readNum = 0;
+}
+
+extern bool EcgLog_Read(uint8 *pRec)
+{
+  uint8 pg;
+
+  if(readNum >= EcgLog_Count()) return FALSE;
+
+  // the oldest page is usedPages-1 pages before the head page
+  pg = (uint8)((headPg + ECG_LOG_PAGE_CNT - (usedPages-1) + readNum / ECG_LOG_REC_NUM) % ECG_LOG_PAGE_CNT);
+
+  HalFlashRead(LOG_PAGE(pg), ECG_LOG_HEAD_LEN + (readNum % ECG_LOG_REC_NUM)*ECG_LOG_REC_LEN,
+               pRec, ECG_LOG_REC_LEN);
+  readNum++;
+  return TRUE;
+}
+
+// mark the used pages as cleared instead of erasing them,
+// a page is erased only when it is used again
+extern void EcgLog_Clear(void)
+{
+  static uint32 cleared = 0; // in XDATA for the flash DMA
+  uint8 pg = headPg;
+
+  while(usedPages != 0)
+  {
+    writeFlash(pg, 4, (uint8*)&cleared, 4);
+    pg = PREV_PAGE(pg);
+    usedPages--;
+  }
+  headOpen = FALSE;
+  readNum = 0;
+}
+
+static bool readHead(uint8 pg, pageHead_t *pHead)
+{
+  HalFlashRead(LOG_PAGE(pg), 0, (uint8*)pHead, sizeof(pageHead_t));
+  return (pHead->magic == ECG_LOG_MAGIC);
+}
+
+static void writeFlash(uint8 pg, uint16 offset, uint8 *pBuf, uint16 len)
+{
+  uint16 addr = (uint16)(((uint32)LOG_PAGE(pg)*HAL_FLASH_PAGE_SIZE + offset) / HAL_FLASH_WORD_SIZE);
+  HalFlashWrite(addr, pBuf, len / HAL_FLASH_WORD_SIZE);
+}
+
+// the next page is erased and begun, if it held the oldest records they are lost
+static void openPage(void)
+{
+  static pageHead_t head; // in XDATA for the flash DMA
+
+  if(hasPage)
+  {
+    headPg = NEXT_PAGE(headPg);
+    headSeq++;
+  }
+  hasPage = TRUE;
+
+  HalFlashErase(LOG_PAGE(headPg));
+  head.seq = headSeq;
+  head.magic = ECG_LOG_MAGIC;
+  head.cleared = 0xFFFFFFFF;
+  // only the first word is written, the cleared word is left erased
+  writeFlash(headPg, 0, (uint8*)&head, 4);
+
+  headOpen = TRUE;
+  headRec = 0;
+  if(usedPages < ECG_LOG_PAGE_CNT) usedPages++;
+}
+#endif // ECG_LOG
@@ -0,0 +1,47 @@
+/*
+ * EcgLog.h : offline ecg/RR log in a circular range of internal flash pages
+ *
+ * Each page begins with an 8 bytes header:
+ *   byte 0..1  : page sequence number, incremented for each new page
+ *   byte 2..3  : ECG_LOG_MAGIC
+ *   byte 4..7  : 0xFFFFFFFF, or 0 when the page was downloaded and cleared
+ * followed by ECG_LOG_REC_NUM records of ECG_LOG_REC_LEN bytes, byte 0 is the record type.
+ * An erased record has the type 0xFF.
+ *
+ * The pages are used in turn, so they wear evenly. When the log is full, the page of
+ * the oldest records is erased and used again.
+ */
+
+#ifndef ECG_LOG_H
+#define ECG_LOG_H
+
+#include "hal_types.h"
+#include "hal_board_cfg.h"
+
+// the log pages, just below the OSAL NV pages by default.
+// Note: like the NV pages, the log pages must be kept free of code in the linker file
+#ifndef ECG_LOG_PAGE_CNT
+#define ECG_LOG_PAGE_CNT      24
+#endif
+#define ECG_LOG_PAGE_END      (HAL_NV_PAGE_BEG-1)
+#define ECG_LOG_PAGE_BEG      (ECG_LOG_PAGE_END-ECG_LOG_PAGE_CNT+1)
+
+#define ECG_LOG_MAGIC         0x4CEC
+#define ECG_LOG_HEAD_LEN      8
+#define ECG_LOG_REC_LEN       20 // record length, a multiple of the flash word and one notification
+#define ECG_LOG_REC_NUM       ((HAL_FLASH_PAGE_SIZE-ECG_LOG_HEAD_LEN)/ECG_LOG_REC_LEN) // records per page
+
+// record types
+#define ECG_LOG_REC_ECG       0x01 // a Rice coded ecg packet, see EcgCodec.h
+#define ECG_LOG_REC_RR        0x02 // RR intervals: number n, sample rate(uint16), n RR intervals(uint16) in samples
+#define ECG_LOG_REC_EMPTY     0xFF
+#define ECG_LOG_REC_END       0x00 // not stored, notified after the last record of a download
+
+extern void EcgLog_Init(void); // find the log head and tail in the flash
+extern void EcgLog_Append(const uint8 *pRec); // append a record of ECG_LOG_REC_LEN bytes
+extern uint16 EcgLog_Count(void); // the number of records not cleared
+extern void EcgLog_Rewind(void); // set the read position to the oldest record
+extern bool EcgLog_Read(uint8 *pRec); // read the next record, FALSE if none
+extern void EcgLog_Clear(void); // clear all the records
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Energy.c : active time per subsystem and an estimated current budget, build with ENERGY_PROFILE
+ */
+
+#include "Energy.h"
+
+#if defined(ENERGY_PROFILE)
+
+#include "hal_mcu.h"
+#include "OSAL.h"
+#include "bcomdef.h"
+#include "peripheral.h"
+#include "CMTechHRMonitor.h"
+
+extern uint32 halSleepReadTimer( void ); // in hal_sleep.c
+
+#define ST_TICK_MASK      0x00FFFFFFL // the sleep timer is 24 bits
+#define ENERGY_MAX_TICKS  0x40000000L // the profiling stops after 32768s, reset to restart
+
+static uint32 subUs[ENERGY_SUB_NUM]; // own active time of the subsystems, us
+static uint32 inner; // time of the sections ended, us, wrapped
+static uint32 isrNum; // DRDY ISRs, that is ADS1x9x samples
+static uint32 packetNum; // ecg packets sent
+static uint32 elapsed; // profiled time, sleep timer ticks
+static uint32 sleepTicks[2]; // time in PM2 and PM3, sleep timer ticks
+static uint32 lastTick; // sleep timer when the elapsed time was counted last
+static bool full; // the profiled time is too long
+
+static uint32 addElapsed(void); // count the time since the last call, return it
+static uint16 share(uint32 part, uint32 whole, uint32 value); // part*value/whole, saturated at 0xFFFF
+
+extern void Energy_Init(void)
+{
+  T1CTL = 0x09; // Timer 1 free running at tick/32, that is 1us per count
+  Energy_Reset();
+}
+
+extern void Energy_Reset(void)
+{
+  halIntState_t intState;
+  
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  osal_memset(subUs, 0, sizeof(subUs));
+  isrNum = 0;
+  packetNum = 0;
+  elapsed = 0;
+  sleepTicks[0] = sleepTicks[1] = 0;
+  lastTick = halSleepReadTimer();
+  full = FALSE;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+extern void Energy_Begin(Energy_Mark_t *pMark)
+{
+  halIntState_t intState;
+  
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  // Note: read of T1CNTL latches T1CNTH
+  ((uint8*)&pMark->t)[0] = T1CNTL;
+  ((uint8*)&pMark->t)[1] = T1CNTH;
+  pMark->inner = inner;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+// the inner time counted since the beginning belongs to the preempting ISRs and the inner sections
+extern void Energy_End(uint8 sub, Energy_Mark_t *pMark)
+{
+  uint16 now, dur;
+  halIntState_t intState;
+  
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  ((uint8*)&now)[0] = T1CNTL;
+  ((uint8*)&now)[1] = T1CNTH;
+  dur = now - pMark->t; // Timer 1 wraps at 16 bits, so does the subtraction
+  if(!full)
+  {
+    subUs[sub] += dur - (uint16)(inner - pMark->inner);
+    if(sub == ENERGY_ISR) isrNum++;
+  }
+  // the whole section, with the sections inside it, is inner time of the enclosing one.
+  // adding dur to the inner time would count those sections twice
+  inner = pMark->inner + dur;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+}
+
+extern void Energy_SleepEnter(void)
+{
+  addElapsed();
+}
+
+extern void Energy_SleepExit(uint8 pm)
+{
+  uint32 ticks = addElapsed();
+  
+  if(!full) sleepTicks[(pm == 3) ? 1 : 0] += ticks;
+}
+
+extern void Energy_AddPacket(void)
+{
+  if(!full) packetNum++;
+}
+
+extern uint8 Energy_Pack(uint8 *pBuf)
+{
+  uint16 v[ENERGY_STAT_LEN/2];
+  uint32 us[ENERGY_SUB_NUM];
+  uint32 isr, ms, ms1, events, idleEvents;
+  uint16 interval = 0, latency = 0, sum = 0, active;
+  uint8 i;
+  halIntState_t intState;
+  
+  HAL_ENTER_CRITICAL_SECTION(intState);
+  osal_memcpy(us, subUs, sizeof(subUs));
+  isr = isrNum;
+  HAL_EXIT_CRITICAL_SECTION(intState);
+  addElapsed();
+  
+  osal_memset(v, 0, sizeof(v));
+  ms = ((elapsed >> 5) * 125) >> 7; // 1000/32768 ms per tick
+  if(ms != 0)
+  {
+    v[0] = (uint16)(elapsed >> 15);
+    
+    // us*ENERGY_MCU_UA/(ms*1000) uA
+    for(i = 0; i < ENERGY_SUB_NUM; i++)
+    {
+      v[1+i] = share(us[i], ms, ENERGY_MCU_UA/100);
+      sum += v[1+i];
+    }
+    active = share(elapsed - sleepTicks[0] - sleepTicks[1], elapsed, (uint32)ENERGY_MCU_UA*10);
+    v[6] = (active > sum) ? active - sum : 0;
+    v[7] = share(sleepTicks[0], elapsed, 1000);
+    v[8] = share(sleepTicks[1], elapsed, 1000);
+    
+    // the connection events: one per interval with packets to send, one per interval*(latency+1) without
+    GAPRole_GetParameter(GAPROLE_CONN_INTERVAL, &interval);
+    GAPRole_GetParameter(GAPROLE_CONN_LATENCY, &latency);
+    if(interval != 0)
+    {
+      events = ms*4 / ((uint32)interval*5); // 1.25ms interval unit
+      idleEvents = events / (latency+1);
+      if(events > packetNum) events = packetNum;
+      if(events < idleEvents) events = idleEvents;
+      v[9] = share(events, ms, (uint32)ENERGY_RF_EVENT_NC*10) + share(packetNum, ms, (uint32)ENERGY_RF_PACKET_NC*10);
+    }
+    
+    // the ADS1x9x converts while there are DRDY ISRs
+    ms1 = (isr / SAMPLERATE) * 1000 + (isr % SAMPLERATE) * 1000 / SAMPLERATE;
+    v[10] = share(ms1, ms, (uint32)ENERGY_ADS_UA*10);
+  }
+  
+  for(i = 0; i < ENERGY_STAT_LEN/2; i++)
+  {
+    *pBuf++ = LO_UINT16(v[i]);
+    *pBuf++ = HI_UINT16(v[i]);
+  }
+  return ENERGY_STAT_LEN;
+}
+
+static uint32 addElapsed(void)
+{
+  uint32 now = halSleepReadTimer();
+  uint32 ticks = (now - lastTick) & ST_TICK_MASK;
+  
+  lastTick = now;
+  if(!full)
+  {
+    elapsed += ticks;
+    if(elapsed >= ENERGY_MAX_TICKS) full = TRUE;
+  }
+  return ticks;
+}
+
+// both are scaled down to keep the product in 32 bits
+static uint16 share(uint32 part, uint32 whole, uint32 value)
+{
+  uint32 r;
+  
+  while(part > 0xFFFFFFFF/value)
+  {
+    part >>= 1;
+    whole >>= 1;
+  }
+  if(whole == 0) return (part == 0) ? 0 : 0xFFFF;
+  r = part*value/whole;
+  return (r > 0xFFFF) ? 0xFFFF : (uint16)r;
+}
+#endif // ENERGY_PROFILE
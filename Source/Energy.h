@@ -0,0 +1,72 @@
+/*
+ * Energy.h : active time per subsystem and an estimated current budget, build with ENERGY_PROFILE
+ *
+ * The active sections are timed with Timer 1 in 1us ticks, like the DRDY ISR profiling, so a section
+ * must be shorter than 65ms. A section is charged only its own time: the ISRs preempting it and the
+ * sections inside it are charged to their own subsystems. The sleep is timed with the sleep timer
+ * per power mode, which keeps running in PM2/PM3.
+ * The current of each part is its share of the profiled time times the model current of the part.
+ * The radio is modelled from the connection parameters and the ecg packets sent: a connection
+ * event per interval while there are packets, and per interval*(latency+1) otherwise.
+ * The model currents are typical datasheet values at 3V, calibrate them against a measured board.
+ *
+ * Packed budget, uint16 little-endian:
+ *   0     : profiled time, s
+ *   1..5  : MCU current of the DRDY ISR, the ecg processing, the notifications, the other HRM events
+ *           and the spin delays, 0.1uA
+ *   6     : MCU current of the rest of the active time, that is the BLE stack and OSAL, 0.1uA
+ *   7..8  : PM2 and PM3 residency, 1/1000
+ *   9     : radio current, 0.1uA
+ *   10    : ADS1x9x current, 0.1uA
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "hal_types.h"
+
+#if defined(ENERGY_PROFILE)
+
+// model currents
+#ifndef ENERGY_MCU_UA
+#define ENERGY_MCU_UA       6100  // uA, MCU active at 32MHz, a multiple of 100 up to 6500
+#endif
+#ifndef ENERGY_RF_EVENT_NC
+#define ENERGY_RF_EVENT_NC  20000 // nC, a connection event with empty packets, from the wakeup to the sleep
+#endif
+#ifndef ENERGY_RF_PACKET_NC
+#define ENERGY_RF_PACKET_NC 5000  // nC, more for each ecg packet sent in a connection event
+#endif
+#ifndef ENERGY_ADS_UA
+#define ENERGY_ADS_UA       150   // uA, ADS1x9x converting with the RLD
+#endif
+
+// subsystems
+#define ENERGY_ISR          0     // DRDY ISR
+#define ENERGY_ECG          1     // ecg processing, HRM_ECG_DATA_EVT
+#define ENERGY_NOTI         2     // notifications, HR/ECG/log/template events
+#define ENERGY_TASK         3     // the other HRM events
+#define ENERGY_DELAY        4     // delayus spins
+#define ENERGY_SUB_NUM      5
+
+#define ENERGY_STAT_LEN     22    // length of the packed budget
+
+// the beginning of a timed section
+typedef struct
+{
+  uint16 t;     // Timer 1 count
+  uint32 inner; // the inner time counted at the beginning
+} Energy_Mark_t;
+
+extern void Energy_Init(void); // start Timer 1 and the profiling
+extern void Energy_Reset(void); // restart the profiling
+extern void Energy_Begin(Energy_Mark_t *pMark); // begin a section
+extern void Energy_End(uint8 sub, Energy_Mark_t *pMark); // end a section and charge it to the subsystem
+extern void Energy_SleepEnter(void); // called by halSleep just before sleeping
+extern void Energy_SleepExit(uint8 pm); // called by halSleep just after waking up from the power mode pm
+extern void Energy_AddPacket(void); // an ecg packet was sent
+extern uint8 Energy_Pack(uint8 *pBuf); // pack the budget, return the length
+
+#endif // ENERGY_PROFILE
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Hrv.c : streaming heart rate variability over a sliding window of RR intervals
+ */
+
+#include "Hrv.h"
+#include "OSAL.h"
+
+#define HRV_WIN_MASK        (HRV_WIN_LEN-1)
+#define HRV_REF_MAX_OFFSET  64 // move the reference to the mean when they are further apart, ms
+
+// cos(2*pi*i/HRV_WIN_LEN) * 127
+static const int8 cosTab[HRV_WIN_LEN] =
+{
+  127, 126, 124, 121, 117, 112, 105,  98,  90,  81,  71,  60,  49,  37,  25,  12,
+    0, -12, -25, -37, -49, -60, -71, -81, -90, -98,-105,-112,-117,-121,-124,-126,
+ -127,-126,-124,-121,-117,-112,-105, -98, -90, -81, -71, -60, -49, -37, -25, -12,
+    0,  12,  25,  37,  49,  60,  71,  81,  90,  98, 105, 112, 117, 121, 124, 126
+};
+
+static void addDiff(HrvState_t *h, uint16 a, uint16 b, int8 sign); // add or remove the difference b-a
+static void moveRef(HrvState_t *h); // move the reference to the mean
+static uint16 isqrt(uint32 x); // integer square root
+static uint32 bandPower(HrvState_t *h, uint32 fLow, uint32 fHigh); // DFT power in [fLow, fHigh), 0.01Hz unit
+
+extern void Hrv_Init(HrvState_t *h)
+{
+  osal_memset(h, 0, sizeof(HrvState_t));
+}
+
+extern void Hrv_AddRR(HrvState_t *h, uint16 rr)
+{
+  uint16 old = 0;
+  int16 x;
+  uint8 k, a;
+  int16 d;
+
+  if(rr < HRV_RR_MIN || rr > HRV_RR_MAX) return;
+
+  if(h->n == 0) h->ref = rr;
+
+  // remove the oldest RR interval when the window is full
+  if(h->n == HRV_WIN_LEN)
+  {
+    old = h->rr[h->pos];
+    addDiff(h, old, h->rr[(h->pos+1) & HRV_WIN_MASK], -1);
+    d = (int16)(old - h->ref);
+    h->sum -= old;
+    h->sumD -= d;
+    h->sumD2 -= (uint32)((int32)d*d);
+    h->n--;
+  }
+
+  // add the new one
+  if(h->n != 0)
+    addDiff(h, h->rr[(h->pos-1) & HRV_WIN_MASK], rr, 1);
+  d = (int16)(rr - h->ref);
+  h->sum += rr;
+  h->sumD += d;
+  h->sumD2 += (uint32)((int32)d*d);
+  h->n++;
+
+  // the new RR interval takes the place of the old one, so their phase is the same.
+  // the bins are updated with the change, and stay exact in integers
+  x = (int16)(rr - old);
+  for(k = 1; k <= HRV_BIN_NUM; k++)
+  {
+    a = (uint8)(k * h->pos) & HRV_WIN_MASK;
+    h->re[k-1] += (int32)x * cosTab[a];
+    h->im[k-1] += (int32)x * cosTab[(a - HRV_WIN_LEN/4) & HRV_WIN_MASK];
+  }
+
+  h->rr[h->pos] = rr;
+  h->pos = (h->pos+1) & HRV_WIN_MASK;
+
+  moveRef(h);
+}
+
+extern uint8 Hrv_Pack(HrvState_t *h, uint8 *pBuf)
+{
+  uint16 mean = 0, sdnn = 0, rmssd = 0, ratio = 0;
+  uint8 pnn50 = 0;
+  int32 m16;
+  uint32 var, lf, hf;
+
+  if(h->n != 0)
+  {
+    mean = (uint16)(h->sum / h->n);
+
+    // var = E(D^2) - E(D)^2, the mean deviation in 1/16ms keeps the rounding small
+    m16 = (h->sumD * 16) / h->n;
+    var = h->sumD2 / h->n;
+    m16 = (m16 * m16) >> 8;
+    var = (var > (uint32)m16) ? var - (uint32)m16 : 0;
+    sdnn = isqrt(var);
+  }
+
+  if(h->n > 1)
+  {
+    rmssd = isqrt(h->sumDiff2 / (h->n-1));
+    pnn50 = (uint8)(((uint16)h->nn50 * 100) / (h->n-1));
+  }
+
+  // the DC part cancels out of the bins only when the window is full
+  if(h->n == HRV_WIN_LEN)
+  {
+    lf = bandPower(h, 4, 15);  // 0.04-0.15Hz
+    hf = bandPower(h, 15, 40); // 0.15-0.4Hz
+    while(lf >= 0x01000000)
+    {
+      lf >>= 1;
+      hf >>= 1;
+    }
+    if(hf == 0)
+      ratio = 0xFFFF;
+    else
+    {
+      lf = (lf << 8) / hf;
+      ratio = (lf > 0xFFFF) ? 0xFFFF : (uint16)lf;
+    }
+  }
+
+  pBuf[0] = h->n;
+  pBuf[1] = LO_UINT16(mean);
+  pBuf[2] = HI_UINT16(mean);
+  pBuf[3] = LO_UINT16(sdnn);
+  pBuf[4] = HI_UINT16(sdnn);
+  pBuf[5] = LO_UINT16(rmssd);
+  pBuf[6] = HI_UINT16(rmssd);
+  pBuf[7] = pnn50;
+  pBuf[8] = LO_UINT16(ratio);
+  pBuf[9] = HI_UINT16(ratio);
+  return HRV_PACK_LEN;
+}
+
+static void addDiff(HrvState_t *h, uint16 a, uint16 b, int8 sign)
+{
+  int16 diff = (int16)(b - a);
+  uint32 diff2 = (uint32)((int32)diff*diff);
+
+  if(sign > 0)
+  {
+    h->sumDiff2 += diff2;
+    if(diff > 50 || diff < -50) h->nn50++;
+  }
+  else
+  {
+    h->sumDiff2 -= diff2;
+    if(diff > 50 || diff < -50) h->nn50--;
+  }
+}
+
+// sum(D-t)^2 = sumD2 - 2*t*sumD + n*t^2, sum(D-t) = sumD - n*t
+static void moveRef(HrvState_t *h)
+{
+  int16 t = (int16)(h->sumD / h->n);
+
+  if(t <= HRV_REF_MAX_OFFSET && t >= -HRV_REF_MAX_OFFSET) return;
+
+  h->sumD2 = h->sumD2 - 2*t*h->sumD + (uint32)h->n*((int32)t*t);
+  h->sumD -= (int32)h->n*t;
+  h->ref += t;
+}
+
+static uint16 isqrt(uint32 x)
+{
+  uint32 r = 0;
+  uint32 bit = 0x40000000;
+
+  while(bit > x) bit >>= 2;
+  while(bit != 0)
+  {
+    if(x >= r + bit)
+    {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else
+    {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16)r;
+}
+
+// the frequency of bin k is k/(sum/1000) Hz, as sum = HRV_WIN_LEN*meanRR in ms
+static uint32 bandPower(HrvState_t *h, uint32 fLow, uint32 fHigh)
+{
+  uint8 k;
+  uint32 f, p = 0;
+  int32 re, im;
+
+  for(k = 1; k <= HRV_BIN_NUM; k++)
+  {
+    f = (uint32)k * 100000; // compared with fLow*sum, in 0.01Hz*ms
+    if(f < fLow * h->sum || f >= fHigh * h->sum) continue;
+    re = h->re[k-1] >> 10;
+    im = h->im[k-1] >> 10;
+    p += (uint32)(re*re) + (uint32)(im*im);
+  }
+  return p;
+}
@@ -0,0 +1,51 @@
+/*
+ * Hrv.h : streaming heart rate variability over a sliding window of RR intervals
+ *
+ * Each RR interval updates the window sums and a sliding DFT of the RR series, so a beat
+ * takes the same time whatever the window length. The metrics are worked out from the sums
+ * only when they are read.
+ *
+ * The DFT treats the RR series as evenly sampled at the mean RR interval, so the frequency
+ * of bin k is k/(HRV_WIN_LEN*meanRR). With a 64 beats window and a 0.8s mean RR interval,
+ * the bins are about 0.02Hz apart, which is enough for the LF/HF ratio.
+ *
+ * Packed result, little-endian:
+ *   byte 0     : the number of RR intervals in the window
+ *   byte 1..2  : mean RR interval, ms
+ *   byte 3..4  : SDNN, ms
+ *   byte 5..6  : RMSSD, ms
+ *   byte 7     : pNN50, %
+ *   byte 8..9  : LF/HF ratio, 1/256 unit, 0 until the window is full, 0xFFFF if no HF power
+ */
+
+#ifndef HRV_H
+#define HRV_H
+
+#include "hal_types.h"
+
+#define HRV_WIN_LEN         64   // RR intervals in the window, must be a power of 2
+#define HRV_BIN_NUM         (HRV_WIN_LEN/2) // DFT bins 1..HRV_WIN_LEN/2
+#define HRV_RR_MIN          250  // RR intervals out of the range are not used, ms
+#define HRV_RR_MAX          2500
+#define HRV_PACK_LEN        10   // length of the packed result
+
+typedef struct
+{
+  uint16 rr[HRV_WIN_LEN]; // the window, ms
+  uint8 pos;              // the window position of the next RR interval
+  uint8 n;                // the number of RR intervals in the window
+  uint32 sum;             // sum of the RR intervals
+  uint16 ref;             // reference of the deviations below
+  int32 sumD;             // sum of RR-ref
+  uint32 sumD2;           // sum of (RR-ref)^2
+  uint32 sumDiff2;        // sum of the squared successive differences
+  uint8 nn50;             // the number of successive differences more than 50ms
+  int32 re[HRV_BIN_NUM];  // sliding DFT of the bins 1..HRV_BIN_NUM
+  int32 im[HRV_BIN_NUM];
+} HrvState_t;
+
+extern void Hrv_Init(HrvState_t *h); // empty the window
+extern void Hrv_AddRR(HrvState_t *h, uint16 rr); // add a RR interval in ms
+extern uint8 Hrv_Pack(HrvState_t *h, uint8 *pBuf); // pack the metrics, return the length
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Resp.c : breathing rate from the decimated respiration signal
+ */
+
+#include "Resp.h"
+#include "OSAL.h"
+
+#define RESP_DC_SHIFT       5 // baseline time constant 2^5 samples, about 0.025Hz
+#define RESP_DECAY_SHIFT    6 // the peak and trough move 1/2^6 of the span to each other per sample
+#define RESP_RATE_SHIFT     2 // the rate moves 1/4 of the way to each new breath
+
+static void addBreath(RespState_t *r, uint8 intv); // a breath found intv samples after the last one
+
+extern void Resp_Init(RespState_t *r)
+{
+  osal_memset(r, 0, sizeof(RespState_t));
+}
+
+extern void Resp_Add(RespState_t *r, int16 x)
+{
+  int16 mid, th, decay;
+
+  if(!r->started)
+  {
+    r->started = TRUE;
+    r->dc = (int32)x << 4;
+  }
+
+  // a drift leaves a constant offset after the baseline removal, the peak and trough follow it
+  r->dc += (((int32)x << 4) - r->dc) >> RESP_DC_SHIFT;
+  x -= (int16)(r->dc >> 4);
+  r->lp += (x - r->lp) >> 1;
+  decay = (r->hi - r->lo) >> RESP_DECAY_SHIFT;
+  if(r->lp > r->hi) r->hi = r->lp; else r->hi -= decay;
+  if(r->lp < r->lo) r->lo = r->lp; else r->lo += decay;
+
+  if(r->sinceBreath < 0xFF) r->sinceBreath++;
+
+  // no breath for too long, the rate is not known any more
+  if(r->sinceBreath > 2*RESP_INTV_MAX)
+  {
+    r->hasBreath = FALSE;
+    r->rate = 0;
+  }
+
+  mid = r->lo + ((r->hi - r->lo) >> 1);
+  th = (r->hi - r->lo) >> 2;
+  if((th >> 1) < RESP_AMP_MIN) return;
+
+  if(!r->high && r->lp > mid + th)
+  {
+    r->high = TRUE;
+    // a crossing in less than half of the usual breath interval is taken as noise
+    if(r->rate != 0 && r->sinceBreath < (uint8)((60*RESP_RATE*16/2) / r->rate)) return;
+    if(r->hasBreath) addBreath(r, r->sinceBreath);
+    r->hasBreath = TRUE;
+    r->sinceBreath = 0;
+  }
+  else if(r->high && r->lp < mid - th)
+  {
+    r->high = FALSE;
+  }
+}
+
+extern uint8 Resp_Pack(RespState_t *r, uint8 *pBuf)
+{
+  uint16 amp = (uint16)(r->hi - r->lo) >> 1;
+  
+  pBuf[0] = (uint8)((r->rate + 8) >> 4);
+  pBuf[1] = LO_UINT16(amp);
+  pBuf[2] = HI_UINT16(amp);
+  return RESP_PACK_LEN;
+}
+
+static void addBreath(RespState_t *r, uint8 intv)
+{
+  uint16 rate;
+
+  if(intv < RESP_INTV_MIN || intv > RESP_INTV_MAX) return;
+
+  rate = (uint16)((60*RESP_RATE*16 + (intv >> 1)) / intv);
+  if(r->rate == 0)
+    r->rate = rate;
+  else
+    r->rate = (uint16)((int16)r->rate + (((int16)rate - (int16)r->rate) >> RESP_RATE_SHIFT));
+}
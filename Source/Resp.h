@@ -0,0 +1,42 @@
+/*
+ * Resp.h : breathing rate from the decimated respiration signal
+ *
+ * The signal comes at RESP_RATE Hz. Its baseline is removed and it is low-passed, then its
+ * peaks and troughs are followed with a slow decay. Each breath is an upward crossing of
+ * the middle of them, with a hysteresis of a quarter of the span.
+ * The rate is smoothed over the breath intervals, so it is updated once per breath.
+ *
+ * Packed result, little-endian:
+ *   byte 0     : breathing rate, breaths per minute, 0 if no breathing is found
+ *   byte 1..2  : signal amplitude, half of the span, 16 bits ADC unit
+ */
+
+#ifndef RESP_H
+#define RESP_H
+
+#include "hal_types.h"
+
+#define RESP_RATE           5    // Hz, rate of the respiration signal
+#define RESP_INTV_MIN       (RESP_RATE*3/2) // breath intervals out of 1.5s-15s are not used
+#define RESP_INTV_MAX       (RESP_RATE*15)
+#define RESP_AMP_MIN        4    // min amplitude to find the breaths
+#define RESP_PACK_LEN       3    // length of the packed result
+
+typedef struct
+{
+  bool started;      // has a sample been added
+  int32 dc;          // baseline, 1/16 unit
+  int16 lp;          // low-passed signal
+  int16 hi;          // peak
+  int16 lo;          // trough
+  bool high;         // the signal has crossed the upper threshold
+  bool hasBreath;    // a breath has been found
+  uint8 sinceBreath; // samples since the last breath
+  uint16 rate;       // breaths per minute, 1/16 unit, 0 if unknown
+} RespState_t;
+
+extern void Resp_Init(RespState_t *r); // restart
+extern void Resp_Add(RespState_t *r, int16 x); // add a sample of the respiration signal
+extern uint8 Resp_Pack(RespState_t *r, uint8 *pBuf); // pack the result, return the length
+
+#endif
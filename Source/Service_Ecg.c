@@ -12,9 +12,32 @@
 #include "CMUtil.h"
 #include "Service_Ecg.h"
 #include "CMTechHRMonitor.h"
+#include "Hrv.h"
+#include "Sqi.h"
+#if defined(ECG_RESP)
+#include "Resp.h"
+#endif
+#if defined(ADS_ISR_PROFILE)
+#include "Dev_ADS1x9x.H"
+#endif
+#if defined(ENERGY_PROFILE)
+#include "Energy.h"
+#endif
 
 // Position of ECG data packet in attribute array
 #define ECG_PACK_VALUE_POS            2
+// Position of heart rate variability in attribute array
+#define ECG_HRV_VALUE_POS             15
+// Position of signal quality index in attribute array
+#define ECG_SQI_VALUE_POS             18
+// Position of breathing rate in attribute array
+#define ECG_RESP_RATE_VALUE_POS       21
+// Position of beat template in attribute array, after the breathing rate if it is built
+#if defined(ECG_RESP)
+#define ECG_BEAT_TPL_VALUE_POS        24
+#else
+#define ECG_BEAT_TPL_VALUE_POS        21
+#endif
 
 // Ecg service
 CONST uint8 ECGServUUID[ATT_UUID_SIZE] =
@@ -52,6 +75,56 @@ CONST uint8 ECGWorkModeUUID[ATT_UUID_SIZE] =
   CM_UUID(ECG_WORK_MODE_UUID)
 };
 
+// Packet Format characteristic
+CONST uint8 ECGPackFormatUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_PACK_FORMAT_UUID)
+};
+
+// Heart Rate Variability characteristic
+CONST uint8 ECGHrvUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_HRV_UUID)
+};
+
+// Signal Quality Index characteristic
+CONST uint8 ECGSqiUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_SQI_UUID)
+};
+
+#if defined(ECG_RESP)
+// Breathing Rate characteristic
+CONST uint8 ECGRespRateUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_RESP_RATE_UUID)
+};
+#endif
+
+#if defined(ECG_TPL)
+// Beat Template characteristic
+CONST uint8 ECGBeatTplUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_BEAT_TPL_UUID)
+};
+#endif
+
+#if defined(ADS_ISR_PROFILE)
+// DRDY ISR statistics characteristic
+CONST uint8 ECGIsrStatUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_ISR_STAT_UUID)
+};
+#endif
+
+#if defined(ENERGY_PROFILE)
+// Energy budget characteristic
+CONST uint8 ECGEnergyStatUUID[ATT_UUID_SIZE] =
+{ 
+  CM_UUID(ECG_ENERGY_STAT_UUID)
+};
+#endif
+
 static ECGServiceCBs_t* ecgServiceCBs;
 
 // Ecg Service attribute
@@ -79,6 +152,49 @@ static uint8 ecgLeadType = ECG_LEAD_TYPE_I;
 static uint8 ecgWorkModeProps = GATT_PROP_READ | GATT_PROP_WRITE;
 static uint8 ecgWorkMode = 0x00;
 
+// Packet Format Characteristic
+static uint8 ecgPackFormatProps = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 ecgPackFormat = ECG_PACK_FORMAT_RAW;
+
+// Heart Rate Variability Characteristic
+static uint8 ecgHrvProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
+static uint8 ecgHrv[HRV_PACK_LEN] = {0};
+static gattCharCfg_t ecgHrvClientCharCfg[GATT_MAX_NUM_CONN];
+
+// Signal Quality Index Characteristic
+static uint8 ecgSqiProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
+static uint8 ecgSqi[SQI_PACK_LEN] = {0};
+static gattCharCfg_t ecgSqiClientCharCfg[GATT_MAX_NUM_CONN];
+
+#if defined(ECG_RESP)
+// Breathing Rate Characteristic
+static uint8 ecgRespRateProps = GATT_PROP_READ | GATT_PROP_NOTIFY;
+static uint8 ecgRespRate[RESP_PACK_LEN] = {0};
+static gattCharCfg_t ecgRespRateClientCharCfg[GATT_MAX_NUM_CONN];
+#endif
+
+#if defined(ECG_TPL)
+// Beat Template Characteristic
+// Note: the characteristic value is not stored here
+static uint8 ecgBeatTplProps = GATT_PROP_NOTIFY;
+static uint8 ecgBeatTpl = 0;
+static gattCharCfg_t ecgBeatTplClientCharCfg[GATT_MAX_NUM_CONN];
+#endif
+
+#if defined(ADS_ISR_PROFILE)
+// DRDY ISR statistics Characteristic
+// Note: the value is read from the ADS1x9x driver when it is read, writing any value resets it
+static uint8 ecgIsrStatProps = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 ecgIsrStat = 0;
+#endif
+
+#if defined(ENERGY_PROFILE)
+// Energy budget Characteristic
+// Note: the budget is packed when it is read, writing any value restarts the profiling
+static uint8 ecgEnergyStatProps = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 ecgEnergyStat = 0;
+#endif
+
 /*********************************************************************
  * Profile Attributes - Table
  */
@@ -179,7 +295,159 @@ static gattAttribute_t ECGAttrTbl[] =
         GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
         0, 
         &ecgWorkMode 
-      }      
+      },
+      
+    // 6. Packet Format Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgPackFormatProps 
+    },
+
+      // Packet Format Value
+      { 
+        { ATT_UUID_SIZE, ECGPackFormatUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        &ecgPackFormat 
+      },
+      
+    // 7. Heart Rate Variability Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgHrvProps 
+    },
+
+      // Heart Rate Variability Value
+      { 
+        { ATT_UUID_SIZE, ECGHrvUUID },
+        GATT_PERMIT_READ, 
+        0, 
+        ecgHrv 
+      },
+
+      // Heart Rate Variability Client Characteristic Configuration
+      { 
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        (uint8 *) &ecgHrvClientCharCfg 
+      },      
+      
+    // 8. Signal Quality Index Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgSqiProps 
+    },
+
+      // Signal Quality Index Value
+      { 
+        { ATT_UUID_SIZE, ECGSqiUUID },
+        GATT_PERMIT_READ, 
+        0, 
+        ecgSqi 
+      },
+
+      // Signal Quality Index Client Characteristic Configuration
+      { 
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        (uint8 *) &ecgSqiClientCharCfg 
+      },      
+      
+#if defined(ECG_RESP)
+    // 9. Breathing Rate Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgRespRateProps 
+    },
+
+      // Breathing Rate Value
+      { 
+        { ATT_UUID_SIZE, ECGRespRateUUID },
+        GATT_PERMIT_READ, 
+        0, 
+        ecgRespRate 
+      },
+
+      // Breathing Rate Client Characteristic Configuration
+      { 
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        (uint8 *) &ecgRespRateClientCharCfg 
+      },      
+#endif
+      
+#if defined(ECG_TPL)
+    // 10. Beat Template Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgBeatTplProps 
+    },
+
+      // Beat Template Value
+      { 
+        { ATT_UUID_SIZE, ECGBeatTplUUID },
+        0, 
+        0, 
+        &ecgBeatTpl 
+      },
+
+      // Beat Template Client Characteristic Configuration
+      { 
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        (uint8 *) &ecgBeatTplClientCharCfg 
+      },      
+#endif
+      
+#if defined(ADS_ISR_PROFILE)
+    // 11. DRDY ISR Statistics Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgIsrStatProps 
+    },
+
+      // DRDY ISR Statistics Value
+      { 
+        { ATT_UUID_SIZE, ECGIsrStatUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        &ecgIsrStat 
+      },
+#endif
+      
+#if defined(ENERGY_PROFILE)
+    // 12. Energy Budget Declaration
+    { 
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ, 
+      0,
+      &ecgEnergyStatProps 
+    },
+
+      // Energy Budget Value
+      { 
+        { ATT_UUID_SIZE, ECGEnergyStatUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE, 
+        0, 
+        &ecgEnergyStat 
+      },
+#endif
 };
 
 static uint8 readAttrCB( uint16 connHandle, gattAttribute_t *pAttr, 
@@ -202,6 +470,14 @@ bStatus_t ECG_AddService( uint32 services )
 
   // Initialize Client Characteristic Configuration attributes
   GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgPackClientCharCfg );
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgHrvClientCharCfg );
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgSqiClientCharCfg );
+#if defined(ECG_TPL)
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgBeatTplClientCharCfg );
+#endif
+#if defined(ECG_RESP)
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgRespRateClientCharCfg );
+#endif
   
   VOID linkDB_Register(handleConnStatusCB);
 
@@ -248,6 +524,24 @@ extern bStatus_t ECG_SetParameter( uint8 param, uint8 len, void *value )
     case ECG_WORK_MODE:  
       ecgWorkMode = *((uint8*)value);
       break;      
+      
+    case ECG_PACK_FORMAT:  
+      ecgPackFormat = *((uint8*)value);
+      break;      
+      
+    case ECG_HRV:  
+      osal_memcpy(ecgHrv, value, len);
+      break;      
+      
+    case ECG_SQI:  
+      osal_memcpy(ecgSqi, value, len);
+      break;      
+      
+#if defined(ECG_RESP)
+    case ECG_RESP_RATE:  
+      osal_memcpy(ecgRespRate, value, len);
+      break;      
+#endif
 
     default:
       ret = INVALIDPARAMETER;
@@ -282,6 +576,24 @@ extern bStatus_t ECG_GetParameter( uint8 param, void *value )
     case ECG_WORK_MODE:  
       *((uint8*)value) = ecgWorkMode;
       break;      
+      
+    case ECG_PACK_FORMAT:  
+      *((uint8*)value) = ecgPackFormat;
+      break;      
+      
+    case ECG_HRV:  
+      osal_memcpy(value, ecgHrv, HRV_PACK_LEN);
+      break;      
+      
+    case ECG_SQI:  
+      osal_memcpy(value, ecgSqi, SQI_PACK_LEN);
+      break;      
+      
+#if defined(ECG_RESP)
+    case ECG_RESP_RATE:  
+      osal_memcpy(value, ecgRespRate, RESP_PACK_LEN);
+      break;      
+#endif
 
     default:
       ret = INVALIDPARAMETER;
@@ -307,6 +619,87 @@ extern bStatus_t ECG_PacketNotify( uint16 connHandle, attHandleValueNoti_t *pNot
 
   return bleIncorrectMode;
 }
+
+#if defined(ECG_TPL)
+extern bStatus_t ECG_BeatTplNotify( uint16 connHandle, attHandleValueNoti_t *pNoti )
+{
+  uint16 value = GATTServApp_ReadCharCfg( connHandle, ecgBeatTplClientCharCfg );
+
+  // If notifications enabled
+  if ( value & GATT_CLIENT_CFG_NOTIFY )
+  {
+    // Set the handle
+    pNoti->handle = ECGAttrTbl[ECG_BEAT_TPL_VALUE_POS].handle;
+  
+    // Send the notification
+    return GATT_Notification( connHandle, pNoti, FALSE );
+  }
+
+  return bleIncorrectMode;
+}
+#endif
+
+extern bStatus_t ECG_HrvNotify( uint16 connHandle )
+{
+  attHandleValueNoti_t noti;
+  uint16 value = GATTServApp_ReadCharCfg( connHandle, ecgHrvClientCharCfg );
+
+  // If notifications enabled
+  if ( value & GATT_CLIENT_CFG_NOTIFY )
+  {
+    // Set the handle
+    noti.handle = ECGAttrTbl[ECG_HRV_VALUE_POS].handle;
+    noti.len = HRV_PACK_LEN;
+    osal_memcpy(noti.value, ecgHrv, HRV_PACK_LEN);
+  
+    // Send the notification
+    return GATT_Notification( connHandle, &noti, FALSE );
+  }
+
+  return bleIncorrectMode;
+}
+
+extern bStatus_t ECG_SqiNotify( uint16 connHandle )
+{
+  attHandleValueNoti_t noti;
+  uint16 value = GATTServApp_ReadCharCfg( connHandle, ecgSqiClientCharCfg );
+
+  // If notifications enabled
+  if ( value & GATT_CLIENT_CFG_NOTIFY )
+  {
+    // Set the handle
+    noti.handle = ECGAttrTbl[ECG_SQI_VALUE_POS].handle;
+    noti.len = SQI_PACK_LEN;
+    osal_memcpy(noti.value, ecgSqi, SQI_PACK_LEN);
+  
+    // Send the notification
+    return GATT_Notification( connHandle, &noti, FALSE );
+  }
+
+  return bleIncorrectMode;
+}
+
+#if defined(ECG_RESP)
+extern bStatus_t ECG_RespNotify( uint16 connHandle )
+{
+  attHandleValueNoti_t noti;
+  uint16 value = GATTServApp_ReadCharCfg( connHandle, ecgRespRateClientCharCfg );
+
+  // If notifications enabled
+  if ( value & GATT_CLIENT_CFG_NOTIFY )
+  {
+    // Set the handle
+    noti.handle = ECGAttrTbl[ECG_RESP_RATE_VALUE_POS].handle;
+    noti.len = RESP_PACK_LEN;
+    osal_memcpy(noti.value, ecgRespRate, RESP_PACK_LEN);
+  
+    // Send the notification
+    return GATT_Notification( connHandle, &noti, FALSE );
+  }
+
+  return bleIncorrectMode;
+}
+#endif
                                
 static uint8 readAttrCB( uint16 connHandle, gattAttribute_t *pAttr, 
                             uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen )
@@ -336,10 +729,40 @@ static uint8 readAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
        
     case ECG_LEAD_TYPE_UUID:
     case ECG_WORK_MODE_UUID:
+    case ECG_PACK_FORMAT_UUID:
       *pLen = 1;
       pValue[0] = *pAttr->pValue;
       break;
       
+    case ECG_HRV_UUID:
+      *pLen = HRV_PACK_LEN;
+      VOID osal_memcpy( pValue, ecgHrv, HRV_PACK_LEN );
+      break;
+      
+    case ECG_SQI_UUID:
+      *pLen = SQI_PACK_LEN;
+      VOID osal_memcpy( pValue, ecgSqi, SQI_PACK_LEN );
+      break;
+      
+#if defined(ECG_RESP)
+    case ECG_RESP_RATE_UUID:
+      *pLen = RESP_PACK_LEN;
+      VOID osal_memcpy( pValue, ecgRespRate, RESP_PACK_LEN );
+      break;
+#endif
+      
+#if defined(ADS_ISR_PROFILE)
+    case ECG_ISR_STAT_UUID:
+      *pLen = ADS1x9x_PackIsrStat(pValue);
+      break;
+#endif
+      
+#if defined(ENERGY_PROFILE)
+    case ECG_ENERGY_STAT_UUID:
+      *pLen = Energy_Pack(pValue);
+      break;
+#endif
+      
     default:
       *pLen = 0;
       status = ATT_ERR_ATTR_NOT_FOUND;
@@ -365,7 +788,9 @@ static bStatus_t writeAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
     case GATT_CLIENT_CHAR_CFG_UUID:
       status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
                                                offset, GATT_CLIENT_CFG_NOTIFY );
-      if ( status == SUCCESS )
+      // the heart rate variability, the signal quality, the breathing rate and the beat template
+      // are notified with the heart rate, no callback needed
+      if ( status == SUCCESS && pAttr->pValue == (uint8*)ecgPackClientCharCfg )
       {
         uint16 charCfg = BUILD_UINT16( pValue[0], pValue[1] );
 
@@ -382,6 +807,34 @@ static bStatus_t writeAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
         (ecgServiceCBs->pfnEcgServiceCB)(ECG_WORK_MODE_CHANGED);
       }
       break;
+      
+    case ECG_PACK_FORMAT_UUID: 
+      if(len != 1)
+      {
+        status = ATT_ERR_INVALID_VALUE_SIZE;
+      }
+      else if(pValue[0] > ECG_PACK_FORMAT_RICE)
+      {
+        status = ATT_ERR_INVALID_VALUE;
+      }
+      else if(ecgPackFormat != pValue[0])
+      {
+        ecgPackFormat = pValue[0];
+        (ecgServiceCBs->pfnEcgServiceCB)(ECG_PACK_FORMAT_CHANGED);
+      }
+      break;
+      
+#if defined(ADS_ISR_PROFILE)
+    case ECG_ISR_STAT_UUID:
+      ADS1x9x_ResetIsrStat();
+      break;
+#endif
+      
+#if defined(ENERGY_PROFILE)
+    case ECG_ENERGY_STAT_UUID:
+      Energy_Reset();
+      break;
+#endif
  
     default:
       status = ATT_ERR_ATTR_NOT_FOUND;
@@ -402,6 +855,14 @@ static void handleConnStatusCB( uint16 connHandle, uint8 changeType )
            ( !linkDB_Up( connHandle ) ) ) )
     { 
       GATTServApp_InitCharCfg( connHandle, ecgPackClientCharCfg );
+      GATTServApp_InitCharCfg( connHandle, ecgHrvClientCharCfg );
+      GATTServApp_InitCharCfg( connHandle, ecgSqiClientCharCfg );
+#if defined(ECG_TPL)
+      GATTServApp_InitCharCfg( connHandle, ecgBeatTplClientCharCfg );
+#endif
+#if defined(ECG_RESP)
+      GATTServApp_InitCharCfg( connHandle, ecgRespRateClientCharCfg );
+#endif
     }
   }
 }
@@ -12,6 +12,10 @@
 #define ECG_SAMPLE_RATE               3  // sample rate
 #define ECG_LEAD_TYPE                 4  // lead type
 #define ECG_WORK_MODE                 5  // work mode status
+#define ECG_PACK_FORMAT               7  // ecg data packet format
+#define ECG_HRV                       8  // heart rate variability, see Hrv.h
+#define ECG_RESP_RATE                 9  // breathing rate, see Resp.h, only with ECG_RESP
+#define ECG_SQI                       10 // signal quality index, see Sqi.h
 
 // Ecg Service UUIDs
 #define ECG_SERV_UUID                 0xAA40
@@ -20,12 +24,23 @@
 #define ECG_SAMPLE_RATE_UUID          0xAA43
 #define ECG_LEAD_TYPE_UUID            0xAA44
 #define ECG_WORK_MODE_UUID            0xAA45
+#define ECG_ISR_STAT_UUID             0xAA46
+#define ECG_PACK_FORMAT_UUID          0xAA47
+#define ECG_HRV_UUID                  0xAA48
+#define ECG_RESP_RATE_UUID            0xAA49
+#define ECG_SQI_UUID                  0xAA4A
+#define ECG_BEAT_TPL_UUID             0xAA4B
+#define ECG_ENERGY_STAT_UUID          0xAA4C
 
 // Values for Ecg Lead Type
 #define ECG_LEAD_TYPE_I            0x00
 #define ECG_LEAD_TYPE_II           0x01
 #define ECG_LEAD_TYPE_III          0x02
 
+// Values for Ecg Packet Format
+#define ECG_PACK_FORMAT_RAW        0x00 // packet number + int16 samples
+#define ECG_PACK_FORMAT_RICE       0x01 // first difference + Rice code, see EcgCodec.h
+
 // Ecg Service bit fields
 #define ECG_SERVICE                   0x00000001
 
@@ -33,6 +48,7 @@
 #define ECG_PACK_NOTI_ENABLED         0 // ecg data packet notification enabled
 #define ECG_PACK_NOTI_DISABLED        1 // ecg data packet notification disabled
 #define ECG_WORK_MODE_CHANGED         2 // ecg work mode changed
+#define ECG_PACK_FORMAT_CHANGED       3 // ecg data packet format changed
 
 // ecg Service callback function
 typedef void (*ecgServiceCB_t)(uint8 event);
@@ -48,6 +64,14 @@ extern void ECG_RegisterAppCBs( ECGServiceCBs_t* pfnServiceCBs );
 extern bStatus_t ECG_SetParameter( uint8 param, uint8 len, void *value );
 extern bStatus_t ECG_GetParameter( uint8 param, void *value );
 extern bStatus_t ECG_PacketNotify( uint16 connHandle, attHandleValueNoti_t *pNoti );// notify the ecg data packet
+extern bStatus_t ECG_HrvNotify( uint16 connHandle );// notify the heart rate variability set last
+extern bStatus_t ECG_SqiNotify( uint16 connHandle );// notify the signal quality index set last
+#if defined(ECG_TPL)
+extern bStatus_t ECG_BeatTplNotify( uint16 connHandle, attHandleValueNoti_t *pNoti );// notify a beat template packet
+#endif
+#if defined(ECG_RESP)
+extern bStatus_t ECG_RespNotify( uint16 connHandle );// notify the breathing rate set last
+#endif
 
 
 
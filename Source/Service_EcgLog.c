@@ -0,0 +1,319 @@
+/**
+* ecg log service source file: controlling the offline ecg/RR log and downloading it
+*/
+
+#include "bcomdef.h"
+#include "OSAL.h"
+#include "linkdb.h"
+#include "att.h"
+#include "gatt.h"
+#include "gatt_uuid.h"
+#include "gattservapp.h"
+#include "CMUtil.h"
+#include "Service_EcgLog.h"
+#include "EcgLog.h"
+
+#if defined(ECG_LOG)
+
+// Position of log record in attribute array
+#define ECGLOG_DATA_VALUE_POS         2
+
+// Ecg Log service
+CONST uint8 ECGLogServUUID[ATT_UUID_SIZE] =
+{
+  CM_UUID(ECGLOG_SERV_UUID)
+};
+
+// Log Record characteristic
+CONST uint8 ECGLogDataUUID[ATT_UUID_SIZE] =
+{
+  CM_UUID(ECGLOG_DATA_UUID)
+};
+
+// Log Control characteristic
+CONST uint8 ECGLogCtrlUUID[ATT_UUID_SIZE] =
+{
+  CM_UUID(ECGLOG_CTRL_UUID)
+};
+
+static ECGLogServiceCBs_t* ecgLogServiceCBs;
+
+// Ecg Log Service attribute
+static CONST gattAttrType_t ecgLogService = { ATT_UUID_SIZE, ECGLogServUUID };
+
+// Log Record Characteristic
+// Note: the characteristic value is not stored here
+static uint8 ecgLogDataProps = GATT_PROP_NOTIFY;
+static uint8 ecgLogData = 0;
+static gattCharCfg_t ecgLogDataClientCharCfg[GATT_MAX_NUM_CONN];
+
+// Log Control Characteristic
+// Note: the status is packed when it is read
+static uint8 ecgLogCtrlProps = GATT_PROP_READ | GATT_PROP_WRITE;
+static uint8 ecgLogCtrl = ECGLOG_CMD_DISABLE;
+static uint8 ecgLogEnabled = FALSE;
+static uint8 ecgLogDownloading = FALSE;
+
+/*********************************************************************
+ * Profile Attributes - Table
+ */
+
+static gattAttribute_t ECGLogAttrTbl[] =
+{
+  // Ecg Log Service
+  {
+    { ATT_BT_UUID_SIZE, primaryServiceUUID }, /* type */
+    GATT_PERMIT_READ,                         /* permissions */
+    0,                                        /* handle */
+    (uint8 *)&ecgLogService                   /* pValue */
+  },
+
+    // 1. Log Record Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &ecgLogDataProps
+    },
+
+      // Log Record Value
+      {
+        { ATT_UUID_SIZE, ECGLogDataUUID },
+        0,
+        0,
+        &ecgLogData
+      },
+
+      // Log Record Client Characteristic Configuration
+      {
+        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        (uint8 *) &ecgLogDataClientCharCfg
+      },
+
+    // 2. Log Control Declaration
+    {
+      { ATT_BT_UUID_SIZE, characterUUID },
+      GATT_PERMIT_READ,
+      0,
+      &ecgLogCtrlProps
+    },
+
+      // Log Control Value
+      {
+        { ATT_UUID_SIZE, ECGLogCtrlUUID },
+        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
+        0,
+        &ecgLogCtrl
+      },
+};
+
+static uint8 readAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen );
+static bStatus_t writeAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                 uint8 *pValue, uint8 len, uint16 offset );
+static void handleConnStatusCB( uint16 connHandle, uint8 changeType );
+
+// Ecg Log Service Callbacks
+CONST gattServiceCBs_t ecgLogCBs =
+{
+  readAttrCB,  // Read callback function pointer
+  writeAttrCB, // Write callback function pointer
+  NULL                   // Authorization callback function pointer
+};
+
+bStatus_t ECGLog_AddService( uint32 services )
+{
+  uint8 status = SUCCESS;
+
+  // Initialize Client Characteristic Configuration attributes
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, ecgLogDataClientCharCfg );
+
+  VOID linkDB_Register(handleConnStatusCB);
+
+  if ( services & ECGLOG_SERVICE )
+  {
+    // Register GATT attribute list and CBs with GATT Server App
+    status = GATTServApp_RegisterService( ECGLogAttrTbl,
+                                          GATT_NUM_ATTRS( ECGLogAttrTbl ),
+                                          &ecgLogCBs );
+  }
+
+  return ( status );
+}
+
+extern void ECGLog_RegisterAppCBs( ECGLogServiceCBs_t* pfnServiceCBs )
+{
+  ecgLogServiceCBs = pfnServiceCBs;
+
+  return;
+}
+
+extern bStatus_t ECGLog_SetParameter( uint8 param, uint8 len, void *value )
+{
+  bStatus_t ret = SUCCESS;
+  switch ( param )
+  {
+    case ECGLOG_ENABLED:
+      ecgLogEnabled = *((uint8*)value);
+      break;
+
+    case ECGLOG_DOWNLOADING:
+      ecgLogDownloading = *((uint8*)value);
+      break;
+
+    default:
+      ret = INVALIDPARAMETER;
+      break;
+  }
+
+  return ( ret );
+}
+
+extern bStatus_t ECGLog_GetParameter( uint8 param, void *value )
+{
+  bStatus_t ret = SUCCESS;
+  switch ( param )
+  {
+    case ECGLOG_CTRL:
+      *((uint8*)value) = ecgLogCtrl;
+      break;
+
+    case ECGLOG_ENABLED:
+      *((uint8*)value) = ecgLogEnabled;
+      break;
+
+    case ECGLOG_DOWNLOADING:
+      *((uint8*)value) = ecgLogDownloading;
+      break;
+
+    default:
+      ret = INVALIDPARAMETER;
+      break;
+  }
+
+  return ( ret );
+}
+
+extern bStatus_t ECGLog_DataNotify( uint16 connHandle, attHandleValueNoti_t *pNoti )
+{
+  uint16 value = GATTServApp_ReadCharCfg( connHandle, ecgLogDataClientCharCfg );
+
+  // If notifications enabled
+  if ( value & GATT_CLIENT_CFG_NOTIFY )
+  {
+    // Set the handle
+    pNoti->handle = ECGLogAttrTbl[ECGLOG_DATA_VALUE_POS].handle;
+
+    // Send the notification
+    return GATT_Notification( connHandle, pNoti, FALSE );
+  }
+
+  return bleIncorrectMode;
+}
+
+static uint8 readAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                            uint8 *pValue, uint8 *pLen, uint16 offset, uint8 maxLen )
+{
+  bStatus_t status = SUCCESS;
+  uint16 count;
+
+  // Make sure it's not a blob operation (no attributes in the profile are long)
+  if ( offset > 0 )
+  {
+    return ( ATT_ERR_ATTR_NOT_LONG );
+  }
+
+  uint16 uuid = 0;
+  if (utilExtractUuid16(pAttr, &uuid) == FAILURE) {
+    // Invalid handle
+    *pLen = 0;
+    return ATT_ERR_INVALID_HANDLE;
+  }
+
+  switch(uuid)
+  {
+    case ECGLOG_CTRL_UUID:
+      count = EcgLog_Count();
+      *pLen = ECGLOG_CTRL_LEN;
+      pValue[0] = ecgLogEnabled;
+      pValue[1] = ecgLogDownloading;
+      pValue[2] = LO_UINT16(count);
+      pValue[3] = HI_UINT16(count);
+      break;
+
+    default:
+      *pLen = 0;
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
+  }
+
+  return ( status );
+}
+
+static bStatus_t writeAttrCB( uint16 connHandle, gattAttribute_t *pAttr,
+                                 uint8 *pValue, uint8 len, uint16 offset )
+{
+  bStatus_t status = SUCCESS;
+
+  uint16 uuid = 0;
+  if (utilExtractUuid16(pAttr,&uuid) == FAILURE) {
+    // Invalid handle
+    return ATT_ERR_INVALID_HANDLE;
+  }
+
+  switch ( uuid )
+  {
+    case GATT_CLIENT_CHAR_CFG_UUID:
+      status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
+                                               offset, GATT_CLIENT_CFG_NOTIFY );
+      if ( status == SUCCESS )
+      {
+        uint16 charCfg = BUILD_UINT16( pValue[0], pValue[1] );
+
+        (ecgLogServiceCBs->pfnEcgLogServiceCB)( (charCfg == GATT_CFG_NO_OPERATION) ?
+                                ECGLOG_DATA_NOTI_DISABLED :
+                                ECGLOG_DATA_NOTI_ENABLED );
+      }
+      break;
+
+    case ECGLOG_CTRL_UUID:
+      if(len != 1)
+      {
+        status = ATT_ERR_INVALID_VALUE_SIZE;
+      }
+      else if(pValue[0] > ECGLOG_CMD_CLEAR)
+      {
+        status = ATT_ERR_INVALID_VALUE;
+      }
+      else
+      {
+        ecgLogCtrl = pValue[0];
+        (ecgLogServiceCBs->pfnEcgLogServiceCB)(ECGLOG_CMD_RECEIVED);
+      }
+      break;
+
+    default:
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
+  }
+
+  return ( status );
+}
+
+static void handleConnStatusCB( uint16 connHandle, uint8 changeType )
+{
+  // Make sure this is not loopback connection
+  if ( connHandle != LOOPBACK_CONNHANDLE )
+  {
+    // Reset Client Char Config if connection has dropped
+    if ( ( changeType == LINKDB_STATUS_UPDATE_REMOVED )      ||
+         ( ( changeType == LINKDB_STATUS_UPDATE_STATEFLAGS ) &&
+           ( !linkDB_Up( connHandle ) ) ) )
+    {
+      GATTServApp_InitCharCfg( connHandle, ecgLogDataClientCharCfg );
+    }
+  }
+}
+#endif // ECG_LOG
@@ -0,0 +1,52 @@
+/**
+* ecg log service header file: controlling the offline ecg/RR log and downloading it
+*/
+
+#ifndef SERVICE_ECGLOG_H
+#define SERVICE_ECGLOG_H
+
+// Ecg Log Service Parameters
+#define ECGLOG_DATA                   0  // log record
+#define ECGLOG_DATA_CHAR_CFG          1  //
+#define ECGLOG_CTRL                   2  // the last command written
+#define ECGLOG_ENABLED                3  // is the offline log enabled
+#define ECGLOG_DOWNLOADING            4  // is the log being downloaded
+
+// Ecg Log Service UUIDs
+#define ECGLOG_SERV_UUID              0xAA50
+#define ECGLOG_DATA_UUID              0xAA51
+#define ECGLOG_CTRL_UUID              0xAA52
+
+// Ecg Log Control commands
+// reading the control gives: enabled(1 byte), downloading(1 byte), the number of records(uint16)
+#define ECGLOG_CMD_DISABLE            0x00 // do not log when disconnected
+#define ECGLOG_CMD_ENABLE             0x01 // log when disconnected
+#define ECGLOG_CMD_DOWNLOAD           0x02 // notify all the records, then a 1 byte ECG_LOG_REC_END
+#define ECGLOG_CMD_CLEAR              0x03 // clear all the records
+
+#define ECGLOG_CTRL_LEN               4  // length of the control read
+
+// Ecg Log Service bit fields
+#define ECGLOG_SERVICE                0x00000001
+
+// Callback events
+#define ECGLOG_DATA_NOTI_ENABLED      0 // log record notification enabled
+#define ECGLOG_DATA_NOTI_DISABLED     1 // log record notification disabled
+#define ECGLOG_CMD_RECEIVED           2 // a control command written
+
+// ecg log Service callback function
+typedef void (*ecgLogServiceCB_t)(uint8 event);
+
+typedef struct
+{
+  ecgLogServiceCB_t    pfnEcgLogServiceCB;
+} ECGLogServiceCBs_t;
+
+
+extern bStatus_t ECGLog_AddService( uint32 services );
+extern void ECGLog_RegisterAppCBs( ECGLogServiceCBs_t* pfnServiceCBs );
+extern bStatus_t ECGLog_SetParameter( uint8 param, uint8 len, void *value );
+extern bStatus_t ECGLog_GetParameter( uint8 param, void *value );
+extern bStatus_t ECGLog_DataNotify( uint16 connHandle, attHandleValueNoti_t *pNoti );// notify a log record
+
+#endif /* SERVICE_ECGLOG_H */
@@ -0,0 +1,111 @@
+/*
+ * Sqi.c : signal quality index of the ecg, per beat and per window
+ */
+
+#include "Sqi.h"
+#include "OSAL.h"
+
+#define SQI_BASE_SHIFT      6 // baseline time constant 2^6 samples, longer than a QRS
+
+extern void Sqi_Init(SqiState_t *s, uint16 sampleRate, uint16 clip)
+{
+  osal_memset(s, 0, sizeof(SqiState_t));
+  s->sampleRate = sampleRate;
+  s->clip = clip;
+  s->beatPart = SQI_MAX;
+}
+
+extern void Sqi_AddSample(SqiState_t *s, int16 x)
+{
+  int16 base;
+
+  if(!s->started)
+  {
+    s->started = TRUE;
+    s->base = (int32)x << SQI_BASE_SHIFT;
+  }
+
+  s->base += x - (s->base >> SQI_BASE_SHIFT);
+  base = (int16)(s->base >> SQI_BASE_SHIFT);
+
+  if(s->n == 0)
+  {
+    s->baseMin = s->baseMax = base;
+  }
+  else if(base < s->baseMin)
+  {
+    s->baseMin = base;
+  }
+  else if(base > s->baseMax)
+  {
+    s->baseMax = base;
+  }
+
+  if(s->n < 0xFFFF) s->n++;
+  if(s->sinceBeat < 0xFFFF) s->sinceBeat++;
+}
+
+// the separation of the QRS peaks from the noise peaks, times the likeness of the peak to the QRS peaks
+extern uint8 Sqi_AddBeat(SqiState_t *s, int16 peak, int16 qrsMean, int16 noiseMean)
+{
+  uint16 sep = 0, like = 0;
+  int16 dev = (peak > qrsMean) ? peak - qrsMean : qrsMean - peak;
+
+  if(qrsMean > noiseMean)
+    sep = (uint16)((uint32)(qrsMean - noiseMean) * SQI_MAX / qrsMean);
+  if(dev < qrsMean)
+    like = SQI_MAX - (uint16)((uint32)dev * SQI_MAX / qrsMean);
+
+  s->beatSqi = (uint8)(sep * like / SQI_MAX);
+  s->beatSum += s->beatSqi;
+  s->beatNum++;
+  s->sinceBeat = 0;
+  s->beatSeen = TRUE;
+  return s->beatSqi;
+}
+
+extern uint8 Sqi_EndWindow(SqiState_t *s, uint16 clip)
+{
+  uint16 clipPart, wanderPart;
+  uint16 range = (uint16)(s->baseMax - s->baseMin);
+
+  // the detector count may have been restarted, then it is less than the samples
+  s->clipNum = clip - s->clip;
+  if(s->clipNum > s->n) s->clipNum = s->n;
+  s->clip = clip;
+
+  // a window may have no beat with a slow heart rate, then the beats before it are used
+  if(s->beatNum != 0)
+    s->beatPart = (uint8)(s->beatSum / s->beatNum);
+  else if(s->beatSeen && s->sinceBeat >= SQI_NO_BEAT_TIME * s->sampleRate)
+    s->beatPart = 0;
+
+  if(s->n == 0 || (uint32)s->clipNum * 100 >= (uint32)s->n * SQI_CLIP_FULL)
+    clipPart = 0;
+  else
+    clipPart = SQI_MAX - (uint16)((uint32)s->clipNum * 100 * SQI_MAX / ((uint32)s->n * SQI_CLIP_FULL));
+
+  if(range >= SQI_WANDER_FULL)
+    wanderPart = 0;
+  else
+    wanderPart = SQI_MAX - (uint16)((uint32)range * SQI_MAX / SQI_WANDER_FULL);
+
+  s->sqi = (uint8)((uint32)s->beatPart * clipPart * wanderPart / ((uint32)SQI_MAX * SQI_MAX));
+
+  // the range of the next window begins at the current baseline
+  s->n = 0;
+  s->beatNum = 0;
+  s->beatSum = 0;
+  return s->sqi;
+}
+
+extern uint8 Sqi_Pack(SqiState_t *s, uint8 *pBuf)
+{
+  uint16 range = (uint16)(s->baseMax - s->baseMin) >> 4;
+
+  pBuf[0] = s->sqi;
+  pBuf[1] = s->beatSqi;
+  pBuf[2] = (s->clipNum > 0xFF) ? 0xFF : (uint8)s->clipNum;
+  pBuf[3] = (range > 0xFF) ? 0xFF : (uint8)range;
+  return SQI_PACK_LEN;
+}
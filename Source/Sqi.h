@@ -0,0 +1,55 @@
+/*
+ * Sqi.h : signal quality index of the ecg, per beat and per window
+ *
+ * A beat is good when the QRS peaks stand well above the noise peaks of the detector and
+ * the beat peak is like the mean of the last peaks. A window is good when its beats are good,
+ * the high-pass filter of the detector is not saturated and the baseline does not wander.
+ * All the indexes are 0 (bad) to 100 (good). The samples are the detector input.
+ * The detector learns for some seconds before its first beat, the beats are taken as good till then.
+ *
+ * Packed result:
+ *   byte 0     : window index
+ *   byte 1     : index of the last beat
+ *   byte 2     : samples saturated by the detector high-pass filter in the window, up to 255
+ *   byte 3     : baseline range in the window, 16 units, up to 255
+ */
+
+#ifndef SQI_H
+#define SQI_H
+
+#include "hal_types.h"
+
+#define SQI_MAX             100
+#ifndef SQI_WANDER_FULL
+#define SQI_WANDER_FULL     480  // baseline range giving a 0 index, 3mV with 160 units per mV
+#endif
+#define SQI_CLIP_FULL       5    // percent of saturated samples giving a 0 index
+#define SQI_NO_BEAT_TIME    3    // s, the beat index is 0 if no beat is found in this time after a beat
+#define SQI_PACK_LEN        4    // length of the packed result
+
+typedef struct
+{
+  uint16 sampleRate; // Hz
+  bool started;      // has a sample been added
+  int32 base;        // baseline, 1/64 unit
+  int16 baseMin;     // baseline range in the window
+  int16 baseMax;
+  uint16 n;          // samples in the window
+  uint16 clip;       // the saturated samples counted by the detector at the window beginning
+  uint16 clipNum;    // saturated samples in the last window
+  uint16 sinceBeat;  // samples since the last beat
+  bool beatSeen;     // has a beat been added, the beat part is unknown and taken as good till then
+  uint8 beatNum;     // beats in the window
+  uint16 beatSum;    // sum of the beat indexes in the window
+  uint8 beatSqi;     // index of the last beat
+  uint8 beatPart;    // beat part of the window index
+  uint8 sqi;         // index of the last window
+} SqiState_t;
+
+extern void Sqi_Init(SqiState_t *s, uint16 sampleRate, uint16 clip); // restart, clip is the detector count
+extern void Sqi_AddSample(SqiState_t *s, int16 x); // add a detector input sample
+extern uint8 Sqi_AddBeat(SqiState_t *s, int16 peak, int16 qrsMean, int16 noiseMean); // add a beat, return its index
+extern uint8 Sqi_EndWindow(SqiState_t *s, uint16 clip); // end the window, return its index
+extern uint8 Sqi_Pack(SqiState_t *s, uint8 *pBuf); // pack the result, return the length
+
+#endif
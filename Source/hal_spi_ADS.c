@@ -1,5 +1,19 @@
 
 #include "hal_spi_ADS.h"
+#if defined(ADS_SPI_DMA)
+#include "hal_board.h"
+#include "hal_dma.h"
+
+#if (HAL_UART == TRUE) && (HAL_UART_DMA == 2)
+#error "the ADS SPI DMA uses the same channels as the UART 1 DMA"
+#endif
+
+#define ADS_DMA_U1DBUF  0x70F9 // U1DBUF mapped in XDATA, for the DMA address
+
+static uint8 dmaDummy = ADS_DUMMY_CHAR; // the byte clocked out while reading by DMA, in XDATA for the DMA
+
+static void setADSDma(); //set the SPI 1 RX and TX DMA channels
+#endif
 
 static void setADSCtrlPin(); //set ctrl pins for the ADS chip, e.g. DRDY, START, CS, PWDN
 static void setADSSpiPin();  //set SPI pin for the ADS chip. here use SPI 1, alt.2that isMI:P17, MO:P16, SCLK:P15
@@ -9,6 +23,9 @@ extern void SPI_ADS_Init()
 {
   setADSCtrlPin();
   setADSSpiPin();
+#if defined(ADS_SPI_DMA)
+  setADSDma();
+#endif
 }
 
 // send one byte data, return the sent byte
@@ -51,6 +68,73 @@ extern void SPI_ADS_ReadFrame(uint8* pBuffer, uint16 size)
   return; 
 }
 
+#if defined(ADS_SPI_DMA)
+// read a frame to pBuffer by DMA
+// the RX channel moves each received byte to pBuffer, the TX channel sends the next dummy byte
+// when the previous one is gone. The TX channel is triggered by hand for the first byte.
+extern void SPI_ADS_ReadFrameDMA(uint8* pBuffer, uint8 size)
+{
+  halDMADesc_t *ch = HAL_DMA_GET_DESC1234(HAL_DMA_CH_ADS_RX);
+  HAL_DMA_SET_DEST(ch, pBuffer);
+  HAL_DMA_SET_LEN(ch, size);
+  
+  ch = HAL_DMA_GET_DESC1234(HAL_DMA_CH_ADS_TX);
+  HAL_DMA_SET_LEN(ch, size);
+  
+  U1TX_BYTE = 0;
+  UTX1IF = 0;
+  URX1IF = 0;
+  HAL_DMA_ARM_CH(HAL_DMA_CH_ADS_RX);
+  HAL_DMA_ARM_CH(HAL_DMA_CH_ADS_TX);
+  asm("NOP"); asm("NOP"); asm("NOP"); asm("NOP"); asm("NOP");
+  asm("NOP"); asm("NOP"); asm("NOP"); asm("NOP"); // 9 clocks for arming the channel
+  HAL_DMA_MAN_TRIGGER(HAL_DMA_CH_ADS_TX);
+}
+
+// is a DMA frame in progress
+extern bool SPI_ADS_FrameDMABusy(void)
+{
+  return (HAL_DMA_CH_ARMED(HAL_DMA_CH_ADS_RX) != 0);
+}
+
+// wait the DMA frame to complete
+// the DMA leaves U1TX_BYTE set after the last byte, clear it for the polled functions
+extern void SPI_ADS_WaitFrameDMA(void)
+{
+  while(HAL_DMA_CH_ARMED(HAL_DMA_CH_ADS_RX));
+  U1TX_BYTE = 0;
+}
+
+// set the SPI 1 RX and TX DMA channels, the destination and the length are set for each frame
+static void setADSDma()
+{
+  halDMADesc_t *ch = HAL_DMA_GET_DESC1234(HAL_DMA_CH_ADS_RX);
+  HAL_DMA_SET_SOURCE(ch, ADS_DMA_U1DBUF);
+  HAL_DMA_SET_VLEN(ch, HAL_DMA_VLEN_USE_LEN);
+  HAL_DMA_SET_WORD_SIZE(ch, HAL_DMA_WORDSIZE_BYTE);
+  HAL_DMA_SET_TRIG_MODE(ch, HAL_DMA_TMODE_SINGLE);
+  HAL_DMA_SET_TRIG_SRC(ch, HAL_DMA_TRIG_URX1);
+  HAL_DMA_SET_SRC_INC(ch, HAL_DMA_SRCINC_0);
+  HAL_DMA_SET_DST_INC(ch, HAL_DMA_DSTINC_1);
+  HAL_DMA_SET_IRQ(ch, HAL_DMA_IRQMASK_DISABLE);
+  HAL_DMA_SET_M8(ch, HAL_DMA_M8_USE_8_BITS);
+  HAL_DMA_SET_PRIORITY(ch, HAL_DMA_PRI_HIGH);
+  
+  ch = HAL_DMA_GET_DESC1234(HAL_DMA_CH_ADS_TX);
+  HAL_DMA_SET_SOURCE(ch, &dmaDummy);
+  HAL_DMA_SET_DEST(ch, ADS_DMA_U1DBUF);
+  HAL_DMA_SET_VLEN(ch, HAL_DMA_VLEN_USE_LEN);
+  HAL_DMA_SET_WORD_SIZE(ch, HAL_DMA_WORDSIZE_BYTE);
+  HAL_DMA_SET_TRIG_MODE(ch, HAL_DMA_TMODE_SINGLE);
+  HAL_DMA_SET_TRIG_SRC(ch, HAL_DMA_TRIG_UTX1);
+  HAL_DMA_SET_SRC_INC(ch, HAL_DMA_SRCINC_0);
+  HAL_DMA_SET_DST_INC(ch, HAL_DMA_DSTINC_0);
+  HAL_DMA_SET_IRQ(ch, HAL_DMA_IRQMASK_DISABLE);
+  HAL_DMA_SET_M8(ch, HAL_DMA_M8_USE_8_BITS);
+  HAL_DMA_SET_PRIORITY(ch, HAL_DMA_PRI_GUARANTEED);
+}
+#endif
+
 //
 static void setADSCtrlPin()
 {
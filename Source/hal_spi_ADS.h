@@ -31,5 +31,13 @@ extern uint8 SPI_ADS_ReadByte(); // read one byte by sending a ADS_DUMMY_CHAR
 extern void SPI_ADS_SendFrame(const uint8* pBuffer, uint16 size); //send multibytes
 extern void SPI_ADS_ReadFrame(uint8* pBuffer, uint16 size); //read multibytes
 
+#if defined(ADS_SPI_DMA)
+// read a frame by DMA in the background, the SPI 1 RX/TX DMA triggers pace the bytes
+// the frame is complete when SPI_ADS_FrameDMABusy() turns false
+extern void SPI_ADS_ReadFrameDMA(uint8* pBuffer, uint8 size);
+extern bool SPI_ADS_FrameDMABusy(void); // is a DMA frame in progress
+extern void SPI_ADS_WaitFrameDMA(void); // wait the DMA frame to complete, then the polled functions can be used
+#endif
+
 #endif
 
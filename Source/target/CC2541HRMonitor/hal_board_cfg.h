@@ -183,6 +183,10 @@ extern "C"
 #define HAL_NV_DMA_CH                  0
 #define HAL_DMA_CH_RX                  3
 #define HAL_DMA_CH_TX                  4
+// DMA channels reading the ADS1x9x frames over SPI 1 when ADS_SPI_DMA is defined,
+// the same channels as the UART DMA, which is not used by this board
+#define HAL_DMA_CH_ADS_RX              3
+#define HAL_DMA_CH_ADS_TX              4
 
 #define HAL_NV_DMA_GET_DESC()  HAL_DMA_GET_DESC0()
 #define HAL_NV_DMA_SET_ADDR(a) HAL_DMA_SET_ADDR_DESC0((a))
@@ -55,6 +55,13 @@
 #include "ll_sleep.h"
 #include "ll_timer2.h"
 #include "ll_math.h"
+#if defined(ENERGY_PROFILE)
+extern void Energy_SleepEnter(void); // in Energy.c
+extern void Energy_SleepExit(uint8 pm);
+#endif
+#if defined(ADS_SPI_DMA)
+#include "hal_dma.h"
+#endif
 
 /*******************************************************************************
  * MACROS
@@ -341,6 +348,15 @@ void halSleep( uint32 osal_timeout )
   P1_0 = 0;
 #endif // DEBUG_GPIO
 
+#if defined(ADS_SPI_DMA)
+  // an ADS1x9x frame is being read by DMA, do not stop the clocks under it
+  // Note: the frame takes some tens of us, so just come back later.
+  if ( HAL_DMA_CH_ARMED( HAL_DMA_CH_ADS_RX ) )
+  {
+    return;
+  }
+#endif // ADS_SPI_DMA
+
   // check if sleep should be entered
   if ( (timeout > PM_MIN_SLEEP_TIME) || (timeout == 0) )
   {
@@ -403,7 +419,13 @@ void halSleep( uint32 osal_timeout )
       //       CLEAR_SLEEP_MODE(), which will clear the halSleepPconValue flag
       //       used to enter sleep mode, thereby preventing the device from
       //       missing this interrupt.
+#if defined(ENERGY_PROFILE)
+      Energy_SleepEnter();
+#endif
       HAL_SLEEP_SET_POWER_MODE();
+#if defined(ENERGY_PROFILE)
+      Energy_SleepExit(halPwrMgtMode);
+#endif
 
 #ifdef DEBUG_GPIO
       // TEMP
@@ -0,0 +1,204 @@
+/*
+ * AdsEmu.c : emulated ADS1x9x on the SPI 1 and the port pins of the host stand-ins
+ */
+
+#include <string.h>
+#include "AdsEmu.h"
+#include "iocc2541.h"
+#include "Dev_ADS1x9x.H"
+
+// the CC2541 registers of iocc2541.h
+uint8 P0, P1, P0SEL, P1SEL, P2SEL, P0DIR, P1DIR, P0IEN, P0IFG, PICTL, PERCFG, IEN2;
+uint8 P0IF, P0IE, URX1IE, URX1IF, UTX1IF;
+uint8 U1DBUF, U1CSR, U1GCR, U1BAUD, T1CTL;
+
+AdsEmu_t adsEmu;
+
+extern void PORT0_ISR(void); // Dev_ADS1x9x.c
+
+#define PIN_START   (1<<0)
+#define PIN_RST     (1<<1)
+#define PIN_CS      (1<<2)
+
+// the registers at power up, ADS1292R data sheet
+static const uint8 regsDefault[12] = { 0x00, 0x02, 0x80, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x07, 0x0C };
+
+// the command being clocked in
+static enum { CMD_NONE, CMD_RREG_NUM, CMD_RREG, CMD_WREG_NUM, CMD_WREG } cmd;
+static uint8 regAddr, regNum;
+static uint8 txDone;
+
+static void checkPins(void)
+{
+  if((P1 & PIN_RST) == 0)
+  {
+    if(!adsEmu.inReset) adsEmu.resets++;
+    // in reset the registers and the modes are back to the power up ones
+    memcpy(adsEmu.regs, regsDefault, sizeof(regsDefault));
+    adsEmu.regs[ADS1x9x_REG_DEVID] = adsEmu.devId;
+    adsEmu.rdatac = TRUE;
+    adsEmu.standby = FALSE;
+    adsEmu.inReset = TRUE;
+    adsEmu.frameLen = adsEmu.framePos = 0;
+    cmd = CMD_NONE;
+  }
+  else
+  {
+    adsEmu.inReset = FALSE;
+  }
+}
+
+// clock one byte in from MOSI, return the byte clocked out on MISO
+static uint8 exchange(uint8 mosi)
+{
+  uint8 miso = 0x00;
+  
+  checkPins();
+  if(P1 & PIN_CS)
+  {
+    adsEmu.badBytes++;
+    return 0xFF;
+  }
+  if(adsEmu.inReset)
+  {
+    adsEmu.badBytes++;
+    return 0x00;
+  }
+  adsEmu.spiBytes++;
+  if(adsEmu.stuck) return adsEmu.devId;
+  
+  // the byte clocked out was ready before the byte clocked in
+  if(cmd == CMD_RREG)
+  {
+    miso = (regAddr < sizeof(adsEmu.regs)) ? adsEmu.regs[regAddr] : 0x00;
+    regAddr++;
+    if(--regNum == 0) cmd = CMD_NONE;
+    return miso;
+  }
+  if(adsEmu.rdatac && adsEmu.framePos < adsEmu.frameLen)
+  {
+    miso = adsEmu.frame[adsEmu.framePos++];
+  }
+  
+  switch(cmd)
+  {
+    case CMD_RREG_NUM:
+      regNum = (mosi & 0x1F) + 1;
+      cmd = CMD_RREG;
+      break;
+      
+    case CMD_WREG_NUM:
+      regNum = (mosi & 0x1F) + 1;
+      cmd = CMD_WREG;
+      break;
+      
+    case CMD_WREG:
+      // DEVID and LOFF_STAT are read only
+      if(regAddr < sizeof(adsEmu.regs) && regAddr != ADS1x9x_REG_DEVID && regAddr != ADS1x9x_REG_LOFF_STAT)
+        adsEmu.regs[regAddr] = mosi;
+      regAddr++;
+      if(--regNum == 0) cmd = CMD_NONE;
+      break;
+      
+    default:
+      if(mosi == SDATAC) adsEmu.rdatac = FALSE;
+      else if(mosi == RDATAC) adsEmu.rdatac = TRUE;
+      else if(mosi == STANDBY) adsEmu.standby = TRUE;
+      else if(mosi == WAKEUP) adsEmu.standby = FALSE;
+      else if(!adsEmu.rdatac && (mosi & 0xE0) == RREG)
+      {
+        // the registers are not read in RDATAC mode
+        regAddr = mosi & 0x1F;
+        cmd = CMD_RREG_NUM;
+      }
+      else if(!adsEmu.rdatac && (mosi & 0xE0) == WREG)
+      {
+        regAddr = mosi & 0x1F;
+        cmd = CMD_WREG_NUM;
+      }
+      break;
+  }
+  return miso;
+}
+
+extern uint8 *AdsEmu_SpiTxDone(void)
+{
+  // polled after U1DBUF is written: the byte is clocked, and the flag stays set until cleared
+  if(!txDone)
+  {
+    U1DBUF = exchange(U1DBUF);
+    txDone = 1;
+  }
+  return &txDone;
+}
+
+// the busy wait of CMUtil.c, the pins are sampled
+extern void delayus(uint16 us)
+{
+  adsEmu.delayUs += us;
+  checkPins();
+}
+
+extern void AdsEmu_Init(uint8 devId, bool stuck)
+{
+  memset(&adsEmu, 0, sizeof(adsEmu));
+  adsEmu.devId = devId;
+  adsEmu.stuck = stuck;
+  P1 = 0;
+  checkPins();
+  adsEmu.resets = 0;
+  txDone = 0;
+}
+
+extern uint16 AdsEmu_SampleRate(void)
+{
+  return (uint16)(125 << (adsEmu.regs[ADS1x9x_REG_CONFIG1] & 0x07));
+}
+
+extern bool AdsEmu_Converting(void)
+{
+  checkPins();
+  return !adsEmu.inReset && !adsEmu.standby && !adsEmu.stuck && (P1 & PIN_START);
+}
+
+extern bool AdsEmu_InReset(void)
+{
+  checkPins();
+  return adsEmu.inReset;
+}
+
+// a word of len bytes from the 24 bits full scale data, MSB first
+static uint8 *putWord(uint8 *p, int32 x, uint8 len)
+{
+  if(len == 2) x >>= 8;
+  while(len--) *p++ = (uint8)(x >> (8*len));
+  return p;
+}
+
+extern bool AdsEmu_Drdy(int32 ch1, int32 ch2, uint8 loff)
+{
+  uint8 len = (adsEmu.devId & ADS1x9x_DEVID_RES24) ? 3 : 2;
+  uint8 *p = adsEmu.frame;
+  uint8 status[3];
+  
+  if(!AdsEmu_Converting())
+    return FALSE;
+  
+  // the status bits are 1100, LOFF_STAT[4:0], GPIO[1:0] and 0s
+  status[0] = 0xC0 | ((loff >> 1) & 0x0F);
+  status[1] = (uint8)((loff & 0x01) << 7);
+  status[2] = 0x00;
+  memcpy(p, status, len);
+  p = putWord(p + len, ch1, len);
+  if(adsEmu.devId & ADS1x9x_DEVID_2CH) p = putWord(p, ch2, len);
+  adsEmu.frameLen = (uint8)(p - adsEmu.frame);
+  adsEmu.framePos = 0;
+  adsEmu.drdys++;
+  
+  // the falling edge of DRDY on P0_1
+  P0IFG |= (1<<1);
+  P0IF = 1;
+  if((P0IEN & (1<<1)) && P0IE)
+    PORT0_ISR();
+  return TRUE;
+}
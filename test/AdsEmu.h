@@ -0,0 +1,54 @@
+/*
+ * AdsEmu.h : emulated ADS1x9x on the SPI 1 and the port pins of the host stand-ins
+ *
+ * The emulation parses the commands clocked in on the SPI while CS is low:
+ * SDATAC, RDATAC, RREG, WREG, WAKEUP and STANDBY. It keeps the register file,
+ * resets it when PWDN/RESET is seen low, and converts while START is high, the
+ * chip is awake and not held in reset. AdsEmu_Drdy() makes one conversion: the
+ * frame of the status word and the channel words, in 2 or 3 bytes after the DEVID,
+ * is then clocked out in RDATAC mode, and the DRDY interrupt is raised on P0_1.
+ * The pins are sampled at each SPI byte and each delayus().
+ */
+
+#ifndef ADSEMU_H
+#define ADSEMU_H
+
+#include "hal_types.h"
+
+typedef struct
+{
+  uint8 regs[12];       // the register file
+  uint8 devId;          // DEVID, also the default of the register 0
+  bool stuck;           // the chip does not answer, MISO stays at devId
+  bool rdatac;          // read data continuous mode
+  bool standby;
+  bool inReset;         // PWDN/RESET was seen low
+  uint8 frame[9];       // the frame of the last conversion
+  uint8 frameLen;
+  uint8 framePos;       // the next frame byte clocked out
+  uint32 drdys;         // the DRDYs raised
+  uint32 spiBytes;      // the bytes clocked while CS is low
+  uint32 badBytes;      // the bytes clocked while CS is high or in reset
+  uint32 resets;        // the times PWDN/RESET went low
+  uint32 delayUs;       // the time spent in delayus()
+} AdsEmu_t;
+
+extern AdsEmu_t adsEmu;
+
+// a chip with its DEVID powered off. stuck makes every byte read devId, as a chip not answering
+extern void AdsEmu_Init(uint8 devId, bool stuck);
+
+// the sample rate set in CONFIG1
+extern uint16 AdsEmu_SampleRate(void);
+
+// is the chip converting: out of reset, awake and START high
+extern bool AdsEmu_Converting(void);
+
+// is PWDN/RESET low
+extern bool AdsEmu_InReset(void);
+
+// one conversion of the channels, in 24 bits full scale, and the LOFF_STAT bits.
+// return TRUE if a frame was made and the DRDY interrupt raised
+extern bool AdsEmu_Drdy(int32 ch1, int32 ch2, uint8 loff);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * EcgDecode.c : reference decoder of the Rice coded ecg packets of EcgCodec
+ */
+
+#include "EcgDecode.h"
+#include "EcgCodec.h"
+
+typedef struct
+{
+  const uint8 *p;
+  uint16 pos;     // the next bit
+  uint16 end;     // the bits in the packet
+} BitReader;
+
+// the next bit, -1 past the end
+static int getBit(BitReader *r)
+{
+  int b;
+  
+  if(r->pos >= r->end) return -1;
+  b = (r->p[r->pos >> 3] >> (7 - (r->pos & 0x07))) & 0x01;
+  r->pos++;
+  return b;
+}
+
+// len bits MSB first, -1 past the end
+static long getBits(BitReader *r, int len)
+{
+  long v = 0;
+  int b;
+  
+  while(len--)
+  {
+    if((b = getBit(r)) < 0) return -1;
+    v = (v << 1) | b;
+  }
+  return v;
+}
+
+extern int EcgRice_Decode(const uint8 *pPack, uint8 len, int16 *x, long *pEsc)
+{
+  BitReader r;
+  int k, n, i, b;
+  long q, low, u, d;
+  
+  if(len < ECG_RICE_HEAD_LEN) return -1;
+  k = pPack[1];
+  n = pPack[2];
+  if(k > ECG_RICE_K_MAX || n == 0) return -1;
+  
+  x[0] = (int16)(pPack[3] | (pPack[4] << 8));
+  r.p = pPack;
+  r.pos = ECG_RICE_HEAD_LEN*8;
+  r.end = (uint16)len*8;
+  
+  for(i = 1; i < n; i++)
+  {
+    // the unary quotient ends with a zero bit, or escapes after ECG_RICE_Q_ESC ones
+    for(q = 0; q < ECG_RICE_Q_ESC; q++)
+    {
+      if((b = getBit(&r)) < 0) return -1;
+      if(b == 0) break;
+    }
+    
+    if(q == ECG_RICE_Q_ESC)
+    {
+      if((u = getBits(&r, 16)) < 0) return -1;
+      x[i] = (int16)u;
+      if(pEsc != NULL) (*pEsc)++;
+      continue;
+    }
+    
+    if((low = getBits(&r, k)) < 0) return -1;
+    u = (q << k) | low;
+    // zigzag back: 2d for d >= 0, -2d-1 for d < 0
+    d = (u & 1) ? -((u + 1) >> 1) : (u >> 1);
+    d += x[i-1];
+    if(d < -32768 || d > 32767) return -1;
+    x[i] = (int16)d;
+  }
+  
+  // the packet is cut at the last code, and the unused bits are 0
+  if(((r.pos + 7) >> 3) != len) return -1;
+  while((b = getBit(&r)) >= 0)
+  {
+    if(b != 0) return -1;
+  }
+  return n;
+}
@@ -0,0 +1,18 @@
+/*
+ * EcgDecode.h : reference decoder of the Rice coded ecg packets of EcgCodec
+ *
+ * It is written from the packet layout of EcgCodec.h, not from the coder, and
+ * rejects any packet that does not follow the layout exactly.
+ */
+
+#ifndef ECGDECODE_H
+#define ECGDECODE_H
+
+#include "hal_types.h"
+
+// decode the packet of len bytes into x, which holds 255 samples.
+// return the number of samples, -1 if the packet is not valid.
+// *pEsc, if not NULL, is increased by the number of escaped samples
+extern int EcgRice_Decode(const uint8 *pPack, uint8 len, int16 *x, long *pEsc);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * EcgSynth.c : synthetic ECG and recorded ECG traces for the host tests
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "EcgSynth.h"
+
+// the waves relative to the R peak: time (s), amplitude (mV), width (s)
+static const double waves[][3] =
+{
+  { -0.200,  0.15, 0.025 },   // P
+  { -0.030, -0.12, 0.008 },   // Q
+  {  0.000,  1.20, 0.010 },   // R
+  {  0.030, -0.25, 0.008 },   // S
+  {  0.300,  0.30, 0.045 }    // T
+};
+#define WAVE_NUM  ((int)(sizeof(waves)/sizeof(waves[0])))
+
+static double uniform(EcgSynth *s)
+{
+  s->seed = s->seed * 1103515245UL + 12345UL;
+  return (double)((s->seed >> 8) & 0xFFFF) / 65536.0;
+}
+
+static double nextRR(EcgSynth *s)
+{
+  // +-8 % around the mean
+  return s->rrMean * (0.92 + 0.16 * uniform(s));
+}
+
+extern void EcgSynth_Init(EcgSynth *s, int sampleRate, int bpm, double amp, unsigned long seed)
+{
+  s->sampleRate = sampleRate;
+  s->amp = amp;
+  s->rrMean = 60.0 / bpm;
+  s->noise = 0.02;
+  s->seed = seed;
+  s->n = 0;
+  s->beats = 0;
+  s->r[0] = -s->rrMean;
+  s->r[1] = 0.5;
+  s->r[2] = s->r[1] + nextRR(s);
+}
+
+extern int EcgSynth_Next(EcgSynth *s)
+{
+  double t = (double)s->n / s->sampleRate;
+  double v, dt;
+  int i, j;
+  
+  // the sample nearest to the R peak counts it
+  if(s->n == lround(s->r[1] * s->sampleRate))
+    s->beats++;
+  
+  // keep the sample within the beat of r[1]
+  if(t > s->r[1] + 0.45)
+  {
+    s->r[0] = s->r[1];
+    s->r[1] = s->r[2];
+    s->r[2] = s->r[1] + nextRR(s);
+  }
+  
+  // baseline wander of a breath every 4 s
+  v = 0.1 * sin(2 * M_PI * 0.25 * t);
+  for(i = 0; i < 3; i++)
+  {
+    for(j = 0; j < WAVE_NUM; j++)
+    {
+      dt = t - s->r[i] - waves[j][0];
+      v += waves[j][1] * exp(-dt * dt / (2 * waves[j][2] * waves[j][2]));
+    }
+  }
+  v += s->noise * (2 * uniform(s) - 1);
+  
+  s->n++;
+  return (int)lround(v * s->amp);
+}
+
+extern long EcgTrace_Load(const char *path, int **pData)
+{
+  FILE *f = fopen(path, "r");
+  char line[256], *p, *end;
+  long n = 0, size = 0, v;
+  int *data = NULL;
+  
+  if(f == NULL) return -1;
+  
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    for(p = line; ; p = end)
+    {
+      while(*p == ' ' || *p == '\t' || *p == ',') p++;
+      if(*p == '#') break;
+      v = strtol(p, &end, 10);
+      if(end == p) break;
+      if(n == size)
+      {
+        size = size ? 2 * size : 4096;
+        data = (int *)realloc(data, size * sizeof(int));
+      }
+      data[n++] = (int)v;
+    }
+  }
+  fclose(f);
+  
+  *pData = data;
+  return n;
+}
@@ -0,0 +1,35 @@
+/*
+ * EcgSynth.h : synthetic ECG and recorded ECG traces for the host tests
+ *
+ * The synthetic ECG is a sum of P, Q, R, S and T waves around each R peak,
+ * with a varying RR interval, a baseline wander and a little noise.
+ * A recorded trace is a text file of integer samples, one or more per line,
+ * '#' starts a comment.
+ */
+
+#ifndef ECGSYNTH_H
+#define ECGSYNTH_H
+
+typedef struct
+{
+  int sampleRate;
+  double amp;           // counts per mV
+  double rrMean;        // s
+  double noise;         // mV, peak
+  double r[3];          // the R peaks around the current sample, s
+  long n;               // the samples generated
+  long beats;           // the R peaks passed
+  unsigned long seed;
+} EcgSynth;
+
+// bpm is the mean heart rate, amp the counts per mV
+extern void EcgSynth_Init(EcgSynth *s, int sampleRate, int bpm, double amp, unsigned long seed);
+
+// the next sample, the R peaks are at the sample nearest to each r[]
+extern int EcgSynth_Next(EcgSynth *s);
+
+// read the samples of the trace file path into *pData, which the caller frees.
+// return the number of samples, -1 if the file can not be read
+extern long EcgTrace_Load(const char *path, int **pData);
+
+#endif
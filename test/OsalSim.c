@@ -0,0 +1,146 @@
+/*
+ * OsalSim.c : OSAL events and timers of one task on a virtual clock
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "OSAL.h"
+#include "OsalSim.h"
+
+typedef struct
+{
+  uint16 event;         // 0 if the timer is free
+  uint32 due;           // the tick it expires at
+} SimTimer_t;
+
+OsalSim_Stat_t osalSimStat;
+
+static uint8 simTask;
+static OsalSim_ProcessFn pfnSimProcess;
+static OsalSim_TickFn pfnSimTick;
+static uint16 simEvents;
+static uint32 simNow;
+static SimTimer_t simTimers[OSALSIM_TIMER_NUM];
+
+static SimTimer_t *findTimer(uint16 event)
+{
+  uint8 i;
+  
+  for(i = 0; i < OSALSIM_TIMER_NUM; i++)
+  {
+    if(simTimers[i].event == event) return &simTimers[i];
+  }
+  return NULL;
+}
+
+extern uint8 osal_set_event(uint8 task_id, uint16 event_flag)
+{
+  if(task_id != simTask) return INVALIDPARAMETER;
+  simEvents |= event_flag;
+  return SUCCESS;
+}
+
+extern uint8 osal_clear_event(uint8 task_id, uint16 event_flag)
+{
+  if(task_id != simTask) return INVALIDPARAMETER;
+  simEvents &= ~event_flag;
+  return SUCCESS;
+}
+
+// a running timer of the same event is started again, as the OSAL does
+extern uint8 osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value)
+{
+  SimTimer_t *t = findTimer(event_id);
+  uint16 running = 0;
+  uint8 i;
+  
+  if(task_id != simTask) return INVALIDPARAMETER;
+  if(t == NULL && (t = findTimer(0)) == NULL) return NO_TIMER_AVAIL;
+  t->event = event_id;
+  t->due = simNow + timeout_value;
+  
+  for(i = 0; i < OSALSIM_TIMER_NUM; i++)
+  {
+    if(simTimers[i].event != 0) running++;
+  }
+  if(running > osalSimStat.maxTimers) osalSimStat.maxTimers = running;
+  return SUCCESS;
+}
+
+extern uint8 osal_stop_timerEx(uint8 task_id, uint16 event_id)
+{
+  SimTimer_t *t = findTimer(event_id);
+  
+  if(task_id != simTask || t == NULL) return INVALID_EVENT_ID;
+  t->event = 0;
+  return SUCCESS;
+}
+
+extern void OsalSim_Init(uint8 taskId, OsalSim_ProcessFn pfnProcess, OsalSim_TickFn pfnTick)
+{
+  simTask = taskId;
+  pfnSimProcess = pfnProcess;
+  pfnSimTick = pfnTick;
+  simEvents = 0;
+  simNow = 0;
+  memset(simTimers, 0, sizeof(simTimers));
+  memset(&osalSimStat, 0, sizeof(osalSimStat));
+}
+
+extern uint32 OsalSim_Now(void)
+{
+  return simNow;
+}
+
+extern bool OsalSim_Run(uint32 ms)
+{
+  uint16 calls, events;
+  uint8 i;
+  
+  while(ms--)
+  {
+    for(i = 0; i < OSALSIM_TIMER_NUM; i++)
+    {
+      if(simTimers[i].event != 0 && (int32)(simNow - simTimers[i].due) >= 0)
+      {
+        simEvents |= simTimers[i].event;
+        simTimers[i].event = 0;
+      }
+    }
+    
+    if(pfnSimTick != NULL) pfnSimTick(simNow);
+    
+    for(calls = 0; simEvents != 0; calls++)
+    {
+      if(calls >= OSALSIM_LOOP_MAX)
+      {
+        printf("%lu ms: events %04X still set after %u calls of the task\n", (unsigned long)simNow, simEvents, calls);
+        osalSimStat.spinning = TRUE;
+        return FALSE;
+      }
+      // the events set while the task runs are kept with those it returns
+      events = simEvents;
+      simEvents = 0;
+      simEvents |= pfnSimProcess(simTask, events);
+    }
+    if(calls > osalSimStat.maxCalls) osalSimStat.maxCalls = calls;
+    osalSimStat.calls += calls;
+    osalSimStat.ticks++;
+    simNow++;
+  }
+  return TRUE;
+}
+
+extern bool OsalSim_TimerRunning(uint16 event, uint32 *pLeft)
+{
+  SimTimer_t *t = findTimer(event);
+  
+  if(t == NULL) return FALSE;
+  if(pLeft != NULL) *pLeft = t->due - simNow;
+  return TRUE;
+}
+
+extern uint16 OsalSim_Events(void)
+{
+  return simEvents;
+}
@@ -0,0 +1,47 @@
+/*
+ * OsalSim.h : OSAL events and timers of one task on a virtual clock
+ *
+ * The clock advances in ticks of 1 ms. At each tick the timers due set their
+ * events, the tick callback runs, as the interrupts would, and then the task
+ * processes its events until none is left, like the OSAL loop. The events are
+ * passed to the task all together and it returns those it did not process.
+ */
+
+#ifndef OSALSIM_H
+#define OSALSIM_H
+
+#include "hal_types.h"
+
+#define OSALSIM_TIMER_NUM   16
+#define OSALSIM_LOOP_MAX    1000  // calls of the task in one tick that are taken as a busy loop
+
+typedef uint16 (*OsalSim_ProcessFn)(uint8 taskId, uint16 events);
+typedef void (*OsalSim_TickFn)(uint32 now);
+
+typedef struct
+{
+  uint32 ticks;         // the ms run
+  uint32 calls;         // the calls of the task
+  uint16 maxCalls;      // the most calls of the task in one tick
+  uint16 maxTimers;     // the most timers running at the same time
+  bool spinning;        // the task did not run out of events in a tick
+} OsalSim_Stat_t;
+
+extern OsalSim_Stat_t osalSimStat;
+
+// a task taskId processing its events with pfnProcess, pfnTick may be NULL
+extern void OsalSim_Init(uint8 taskId, OsalSim_ProcessFn pfnProcess, OsalSim_TickFn pfnTick);
+
+// the virtual time in ms
+extern uint32 OsalSim_Now(void);
+
+// run ms ticks, FALSE if the task was spinning
+extern bool OsalSim_Run(uint32 ms);
+
+// is the timer of event running, and the ms left if pLeft is not NULL
+extern bool OsalSim_TimerRunning(uint16 event, uint32 *pLeft);
+
+// the events set and not processed
+extern uint16 OsalSim_Events(void);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * QrsFiltRef.c : the QRS filters as separate stages, for the host tests
+ */
+
+#include "QrsFiltRef.h"
+
+static int lpfilt( QRSRefState *s, int datum ,int init) ;
+static int hpfilt( QRSRefState *s, int datum, int init ) ;
+static int deriv2( QRSRefState *s, int x0, int init ) ;
+static int mvwint( QRSRefState *s, int datum, int init) ;
+
+extern int QRSRefFilter(QRSRefState *s, int datum, int init)
+{
+  int fdatum ;
+  
+  if(init)
+  {
+    hpfilt( s, 0, 1 ) ;		// Initialize filters.
+    lpfilt( s, 0, 1 ) ;
+    mvwint( s, 0, 1 ) ;
+    QRSRefDeriv1( s, 0, 1 ) ;
+    deriv2( s, 0, 1 ) ;
+  }
+  
+  fdatum = hpfilt( s, datum, 0 ) ;	// High pass filter data.
+  fdatum = lpfilt( s, fdatum, 0 ) ;	// Low pass filter data.
+  fdatum = deriv2( s, fdatum, 0 ) ;	// Take the derivative.
+  if(fdatum < 0) fdatum = -fdatum;	// Take the absolute value.
+  fdatum = mvwint( s, fdatum, 0 ) ;	// Average over an 80 ms window .
+  return(fdatum) ;
+}
+
+// y[n] = x[n] - x[n - 10ms]
+extern int QRSRefDeriv1(QRSRefState *s, int x, int init)
+{
+  int y ;
+  
+  if(init != 0)
+  {
+    for(s->der1Ptr = 0; s->der1Ptr < s->p->derivLgth; ++s->der1Ptr)
+      s->der1Buff[s->der1Ptr] = 0 ;
+    s->der1Ptr = 0 ;
+    return(0) ;
+  }
+  
+  y = x - s->der1Buff[s->der1Ptr] ;
+  s->der1Buff[s->der1Ptr] = x ;
+  if(++s->der1Ptr == s->p->derivLgth)
+    s->der1Ptr = 0 ;
+  return(y) ;
+}
+
+// y[n] = 2*y[n-1] - y[n-2] + x[n] - 2*x[t-24 ms] + x[t-48 ms]
+static int lpfilt( QRSRefState *s, int datum ,int init)
+{
+  long y0 ;
+  int output;
+  int halfPtr ;
+  int lgth = s->p->lpLgth ;
+  if(init)
+  {
+    for(s->lpPtr = 0; s->lpPtr < lgth; ++s->lpPtr)
+      s->lpData[s->lpPtr] = 0 ;
+    s->lpY1 = s->lpY2 = 0 ;
+    s->lpPtr = 0 ;
+  }
+  halfPtr = s->lpPtr-(lgth/2) ;	// Use halfPtr to index
+  if(halfPtr < 0)			// to x[n-24 ms].
+    halfPtr += lgth ;
+  y0 = (s->lpY1 << 1) - s->lpY2 + datum - ((long)s->lpData[halfPtr] << 1) + s->lpData[s->lpPtr] ;
+  s->lpY2 = s->lpY1;
+  s->lpY1 = y0;
+  output = (int)(y0 / ((lgth*lgth)/4));
+  s->lpData[s->lpPtr] = datum ;		// Stick most recent sample into
+  if(++s->lpPtr == lgth)		// the circular buffer and update
+    s->lpPtr = 0 ;			// the buffer pointer.
+  return(output) ;
+}
+
+// y[n] = y[n-1] + x[n] - x[n-128 ms]
+// z[n] = x[n-64 ms] - y[n]/HPBUFFER_LGTH, saturated to +-4096
+static int hpfilt( QRSRefState *s, int datum, int init )
+{
+  long z;
+  int halfPtr ;
+  int lgth = s->p->hpLgth ;
+  
+  if(init)
+  {
+    for(s->hpPtr = 0; s->hpPtr < lgth; ++s->hpPtr)
+      s->hpData[s->hpPtr] = 0 ;
+    s->hpPtr = 0 ;
+    s->hpY = 0 ;
+    s->hpClip = 0 ;
+  }
+  
+  s->hpY += (datum - (long)s->hpData[s->hpPtr]);
+  halfPtr = s->hpPtr-(lgth/2) ;
+  if(halfPtr < 0)
+    halfPtr += lgth ;
+  z = s->hpData[halfPtr] - (s->hpY / lgth);
+  
+  s->hpData[s->hpPtr] = datum ;
+  if(++s->hpPtr == lgth)
+    s->hpPtr = 0 ;
+  
+  if(z > 4096 || z < -4096)
+  {
+    ++s->hpClip ;
+    return (z > 0) ? 4096 : -4096 ;
+  }
+  return (int)z;
+}
+
+// y[n] = x[n] - x[n - 10ms]
+static int deriv2(QRSRefState *s, int x, int init)
+{
+  int y ;
+  
+  if(init != 0)
+  {
+    for(s->der2Ptr = 0; s->der2Ptr < s->p->derivLgth; ++s->der2Ptr)
+      s->der2Buff[s->der2Ptr] = 0 ;
+    s->der2Ptr = 0 ;
+    return(0) ;
+  }
+  
+  y = x - s->der2Buff[s->der2Ptr] ;
+  s->der2Buff[s->der2Ptr] = x ;
+  if(++s->der2Ptr == s->p->derivLgth)
+    s->der2Ptr = 0 ;
+  return(y) ;
+}
+
+// the average of the last WINDOW_WIDTH samples
+static int mvwint(QRSRefState *s, int datum, int init)
+{
+  long output;
+  int width = s->p->windowWidth ;
+  if(init)
+  {
+    for(s->mvPtr = 0; s->mvPtr < width ; ++s->mvPtr)
+      s->mvData[s->mvPtr] = 0 ;
+    s->mvSum = 0 ;
+    s->mvPtr = 0 ;
+  }
+  s->mvSum += datum ;
+  s->mvSum -= s->mvData[s->mvPtr] ;
+  s->mvData[s->mvPtr] = datum ;
+  if(++s->mvPtr == width)
+    s->mvPtr = 0 ;
+  
+  output = s->mvSum/width;
+  if(output > 32000) return 32000;
+  return((int)output) ;
+}
@@ -0,0 +1,41 @@
+/*
+ * QrsFiltRef.h : the QRS filters as separate stages, for the host tests
+ *
+ * This is QRSFilter() and deriv1() of qrsfilt.cpp before the stages were fused
+ * into one pass over a shared history: each of hpfilt, lpfilt, deriv2, mvwint
+ * and deriv1 keeps its own buffer and divides with the library division.
+ * The fused filters must give the same outputs sample for sample.
+ */
+
+#ifndef QRSFILTREF_H
+#define QRSFILTREF_H
+
+#include "QRSFILT.H"
+
+typedef struct
+{
+  const QRSFiltParam *p;  // filter lengths for the current sample rate
+  // lpfilt
+  long lpY1, lpY2;
+  int lpData[LPBUFFER_MAX];
+  int lpPtr;
+  // hpfilt
+  long hpY;
+  int hpData[HPBUFFER_MAX];
+  int hpPtr;
+  unsigned int hpClip;
+  // deriv1 and deriv2
+  int der1Buff[DERIV_MAX], der1Ptr;
+  int der2Buff[DERIV_MAX], der2Ptr;
+  // mvwint
+  long mvSum;
+  int mvData[WINDOW_MAX];
+  int mvPtr;
+} QRSRefState;
+
+// p must be set before the filters are initialized
+extern int QRSRefFilter(QRSRefState *s, int datum, int init);
+
+extern int QRSRefDeriv1(QRSRefState *s, int x, int init);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Replay.c : replay an ECG trace through QRSDet() and report the beats and the cost
+ *
+ *   replay [-r rate] [-a annotations] [trace]
+ *
+ * The trace is a text file of samples at the detector scale, 5 uV per count,
+ * with no trace a synthetic ECG of 10 minutes is replayed. The annotations are
+ * the samples of the R peaks, one or more per line. A detection counts as a true
+ * one if it is within 150 ms of an annotated R peak, the sensitivity and the
+ * positive predictivity are reported, leaving out the first 8 s, with the
+ * detection delay and the host time and cycles per sample. The exit status is 1
+ * if either is below 99 %.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "QRSDET.H"
+#include "Bpm.h"
+#include "EcgSynth.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()    __rdtsc()
+#else
+#define CYCLES()    0ULL
+#endif
+
+#define SYNTH_LEN_S   600
+#define MATCH_MS      150
+#define LEARN_S       8
+
+static QRSDetState det;
+
+int main(int argc, char *argv[])
+{
+  const char *tracePath = NULL, *annPath = NULL;
+  int rate = 250, bpm = 0;
+  int *x = NULL, *ann = NULL;
+  long len, annNum = 0, i, j, a;
+  long *det_at;
+  long detNum = 0, detFirst, tp = 0, delaySum = 0, delayMax = 0, win;
+  int delay;
+  struct timespec t0, t1;
+  unsigned long long c0, c1;
+  double ns, sens, ppv;
+  EcgSynth ecg;
+  
+  for(i = 1; i < argc; i++)
+  {
+    if(argv[i][0] == '-' && i+1 < argc && argv[i][1] == 'r') rate = atoi(argv[++i]);
+    else if(argv[i][0] == '-' && i+1 < argc && argv[i][1] == 'a') annPath = argv[++i];
+    else tracePath = argv[i];
+  }
+  
+  if(tracePath != NULL)
+  {
+    len = EcgTrace_Load(tracePath, &x);
+    if(len < 0)
+    {
+      printf("can not read %s\n", tracePath);
+      return 1;
+    }
+    if(annPath != NULL && (annNum = EcgTrace_Load(annPath, &ann)) < 0)
+    {
+      printf("can not read %s\n", annPath);
+      return 1;
+    }
+  }
+  else
+  {
+    // the synthetic ECG annotates its own R peaks
+    len = (long)SYNTH_LEN_S * rate;
+    x = (int *)malloc(len * sizeof(int));
+    ann = (int *)malloc(len * sizeof(int));
+    EcgSynth_Init(&ecg, rate, 75, 200, 3);
+    for(i = 0; i < len; i++)
+    {
+      a = ecg.beats;
+      x[i] = EcgSynth_Next(&ecg);
+      if(ecg.beats != a) ann[annNum++] = (int)i;
+    }
+  }
+  
+  if(!QRSDetInit(&det, rate))
+  {
+    printf("no detector table for %d Hz\n", rate);
+    return 1;
+  }
+  
+  det_at = (long *)malloc((len + 1) * sizeof(long));
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  c0 = CYCLES();
+  for(i = 0; i < len; i++)
+  {
+    // the detector gives the delay from the R peak
+    delay = QRSDet(&det, x[i], 0);
+    if(delay)
+    {
+      det_at[detNum++] = i - delay;
+      delaySum += delay;
+      if(delay > delayMax) delayMax = delay;
+      if(detNum > 1) bpm = Bpm_FromRR((uint16)getRRInterval(&det), (uint16)rate);
+    }
+  }
+  c1 = CYCLES();
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+  
+  printf("%s: %ld samples at %d Hz, %ld beats detected, last %d bpm\n",
+         tracePath ? tracePath : "synthetic ECG", len, rate, detNum, bpm);
+  printf("delay %.0f ms mean, %ld ms max\n",
+         detNum ? 1000.0 * delaySum / detNum / rate : 0.0, 1000L * delayMax / rate);
+  printf("%.1f ns, %.0f host cycles per sample, %.0f times real time\n",
+         ns / len, (double)(c1 - c0) / len, (double)len / rate * 1e9 / ns);
+  
+  if(ann == NULL)
+  {
+    free(x);
+    free(det_at);
+    return 0;
+  }
+  
+  // the beats of the first 8 s, while the detector learns its thresholds, are not scored.
+  // both lists are in time order, each annotation takes at most one detection
+  win = (long)MATCH_MS * rate / 1000;
+  for(i = 0; i < annNum && ann[i] < LEARN_S * rate; i++);
+  for(j = 0; j < detNum && det_at[j] < LEARN_S * rate - win; j++);
+  annNum -= i;
+  detFirst = j;
+  for(a = i; a < i + annNum; a++)
+  {
+    while(j < detNum && det_at[j] < ann[a] - win) j++;
+    if(j < detNum && det_at[j] <= ann[a] + win)
+    {
+      tp++;
+      j++;
+    }
+  }
+  detNum -= detFirst;
+  sens = annNum ? 100.0 * tp / annNum : 0;
+  ppv = detNum ? 100.0 * tp / detNum : 0;
+  printf("%ld annotated beats, %ld found, %ld missed, %ld false, sensitivity %.2f %%, positive predictivity %.2f %%\n",
+         annNum, tp, annNum - tp, detNum - tp, sens, ppv);
+  
+  free(x);
+  free(ann);
+  free(det_at);
+  return (sens < 99.0 || ppv < 99.0);
+}
@@ -0,0 +1,21 @@
+/*
+ * OSAL.h : host stand-in of the OSAL memory, event and timer functions, for the host tests only
+ *
+ * The events and the timers are those of OsalSim.c.
+ */
+
+#ifndef OSAL_H
+#define OSAL_H
+
+#include <string.h>
+#include "comdef.h"
+
+#define osal_memset(p, v, n)    memset((p), (v), (n))
+#define osal_memcpy(d, s, n)    memcpy((d), (s), (n))
+
+extern uint8 osal_set_event(uint8 task_id, uint16 event_flag);
+extern uint8 osal_clear_event(uint8 task_id, uint16 event_flag);
+extern uint8 osal_start_timerEx(uint8 task_id, uint16 event_id, uint32 timeout_value);
+extern uint8 osal_stop_timerEx(uint8 task_id, uint16 event_id);
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * bcomdef.h : host stand-in of the BLE stack common definitions, for the host tests only
+ */
+
+#ifndef BCOMDEF_H
+#define BCOMDEF_H
+
+#include "comdef.h"
+
+typedef Status_t bStatus_t;
+
+#define bleTimeout                0x16
+#define blePending                0x17
+#define bleInvalidRange           0x18
+#define bleMemAllocError          0x13
+#define bleNotConnected           0x14
+#define bleNoResources            0x1A
+
+#define B_ADDR_LEN                6
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * comdef.h : host stand-in of the common definitions, for the host tests only
+ */
+
+#ifndef COMDEF_H
+#define COMDEF_H
+
+#include "hal_types.h"
+
+typedef uint8 Status_t;
+
+#define SUCCESS                   0x00
+#define FAILURE                   0x01
+#define INVALIDPARAMETER          0x02
+#define INVALID_TASK              0x03
+#define MSG_BUFFER_NOT_AVAIL      0x04
+#define INVALID_MSG_POINTER       0x05
+#define INVALID_EVENT_ID          0x06
+#define INVALID_INTERRUPT_ID      0x07
+#define NO_TIMER_AVAIL            0x08
+
+#define VOID                      (void)
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * gatt.h : host stand-in of the GATT definitions, for the host tests only
+ */
+
+#ifndef GATT_H
+#define GATT_H
+
+#include "bcomdef.h"
+#include "OSAL.h"
+
+#define ATT_MTU_SIZE              23
+
+typedef struct
+{
+  uint8 len;
+  const uint8 *uuid;
+} gattAttrType_t;
+
+typedef struct
+{
+  gattAttrType_t type;
+  uint8 permissions;
+  uint16 handle;
+  uint8 *pValue;
+} gattAttribute_t;
+
+typedef struct
+{
+  uint16 handle;
+  uint8 len;
+  uint8 value[ATT_MTU_SIZE-3];
+} attHandleValueNoti_t;
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * hal_mcu.h : host stand-in of the MCU macros, for the host tests only
+ */
+
+#ifndef HAL_MCU_H
+#define HAL_MCU_H
+
+#include "hal_types.h"
+
+typedef uint8 halIntState_t;
+
+#define HAL_ENTER_CRITICAL_SECTION(x)   do { (x) = 0; } while(0)
+#define HAL_EXIT_CRITICAL_SECTION(x)    do { (void)(x); } while(0)
+#define HAL_ENTER_ISR()
+#define HAL_EXIT_ISR()
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * hal_types.h : host stand-in of the HAL types, for the host tests only
+ */
+
+#ifndef HAL_TYPES_H
+#define HAL_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int8_t    int8;
+typedef uint8_t   uint8;
+typedef int16_t   int16;
+typedef uint16_t  uint16;
+typedef int32_t   int32;
+typedef uint32_t  uint32;
+
+#ifndef TRUE
+#define TRUE      1
+#endif
+#ifndef FALSE
+#define FALSE     0
+#endif
+#ifndef NULL
+#define NULL      0
+#endif
+
+#define CONST     const
+
+#define BUILD_UINT16(loByte, hiByte) ((uint16)(((loByte) & 0x00FF) + (((hiByte) & 0x00FF) << 8)))
+#define HI_UINT16(a) (((a) >> 8) & 0xFF)
+#define LO_UINT16(a) ((a) & 0xFF)
+
+#endif
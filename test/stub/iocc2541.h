@@ -0,0 +1,24 @@
+/*
+ * iocc2541.h : host stand-in of the CC2541 registers used by the ADS1x9x driver,
+ *              for the host tests only
+ *
+ * The registers are plain bytes, defined by AdsEmu.c. The SPI 1 transfer done flag
+ * U1TX_BYTE is the one exception: reading it clocks the byte written to U1DBUF out
+ * to the emulated ADS1x9x and puts the byte clocked in back into U1DBUF.
+ */
+
+#ifndef IOCC2541_H
+#define IOCC2541_H
+
+#include "hal_types.h"
+
+extern uint8 P0, P1, P0SEL, P1SEL, P2SEL, P0DIR, P1DIR, P0IEN, P0IFG, PICTL, PERCFG, IEN2;
+extern uint8 P0IF, P0IE, URX1IE, URX1IF, UTX1IF;
+extern uint8 U1DBUF, U1CSR, U1GCR, U1BAUD, T1CTL;
+
+extern uint8 *AdsEmu_SpiTxDone(void);
+#define U1TX_BYTE     (*AdsEmu_SpiTxDone())
+
+#define P0INT_VECTOR  0x6B
+
+#endif
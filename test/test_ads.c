@@ -0,0 +1,175 @@
+/*
+ * test_ads.c : Dev_ADS1x9x.c and hal_spi_ADS.c driving the emulated ADS1x9x
+ *
+ * For each chip the driver is taken through the control sequence of App_HRFunc.c,
+ * power up, standby, wakeup, start, stop, at 125 and 250 Hz. The registers written
+ * are checked in the emulated register file, and every sample converted must reach
+ * the data callback with its channel data, at the resolution of the chip, and its
+ * LOFF_STAT. A chip that does not answer, DEVID 0x00 or 0xFF, must fall back to the
+ * 16 bits, one channel settings. Built with and without ECG_RESP.
+ *
+ *   test_ads [trace]   channel 1 is the trace, in 24 bits full scale
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Dev_ADS1x9x.H"
+#include "CMTechHRMonitor.h"
+#include "AdsEmu.h"
+#include "EcgSynth.h"
+
+#define SIGNAL_LEN    (60L*250)
+
+uint16 SAMPLERATE = ECG_MODE_SAMPLERATE;
+
+static int32 ch1[SIGNAL_LEN], ch2[SIGNAL_LEN];
+static long sigLen = SIGNAL_LEN;
+
+// the samples delivered to the callback
+static long got;
+static int32 gotData, gotResp;
+static uint8 gotLoff;
+
+static void dataCB(int32 data, int32 resp, uint8 loffStat)
+{
+  got++;
+  gotData = data;
+  gotResp = resp;
+  gotLoff = loffStat;
+}
+
+static int runChip(uint8 devId, uint16 rate)
+{
+  bool res24 = (devId & ADS1x9x_DEVID_RES24) != 0;
+  bool resp = FALSE;
+  int32 mask = res24 ? -1L : ~0xFFL;
+  long i, bad = 0;
+  uint8 loff, frameLen;
+  uint32 bytes;
+  clock_t t0;
+  double sec;
+  
+#if defined(ECG_RESP)
+  resp = (devId & ADS1x9x_DEVID_2CH) != 0;
+#endif
+  
+  SAMPLERATE = rate;
+  AdsEmu_Init(devId, FALSE);
+  ADS1x9x_Init(dataCB);
+  ADS1x9x_PowerUp();
+  
+  if(AdsEmu_SampleRate() != rate || adsEmu.regs[ADS1x9x_REG_LOFF_SENS] != 0x03 || ADS1x9x_Is24Bit() != res24)
+  {
+    printf("DEVID %02X %u Hz: registers set for %u Hz, 24 bits %d\n", devId, rate, AdsEmu_SampleRate(), ADS1x9x_Is24Bit());
+    return 1;
+  }
+#if defined(ECG_RESP)
+  if(ADS1x9x_HasResp() != resp || (resp && adsEmu.regs[ADS1x9x_REG_RESP1] != 0xEA))
+  {
+    printf("DEVID %02X: respiration %d\n", devId, ADS1x9x_HasResp());
+    return 1;
+  }
+#endif
+  
+  // no conversion before the start
+  ADS1x9x_StandBy();
+  if(AdsEmu_Drdy(0, 0, 0) || !adsEmu.standby) bad++;
+  ADS1x9x_WakeUp();
+  ADS1x9x_StartConvert();
+  
+  got = 0;
+  frameLen = (uint8)((resp ? 3 : 2) * (res24 ? 3 : 2));
+  t0 = clock();
+  for(i = 0; i < sigLen; i++)
+  {
+    loff = (uint8)((i / 100) & 0x1F);
+    bytes = adsEmu.spiBytes;
+    if(!AdsEmu_Drdy(ch1[i], ch2[i], loff) || got != i+1)
+    {
+      if(bad++ < 5) printf("DEVID %02X %u Hz: sample %ld not delivered\n", devId, rate, i);
+      continue;
+    }
+    if(gotData != (ch1[i] & mask) || gotResp != (resp ? (ch2[i] & mask) : 0) || gotLoff != loff
+       || adsEmu.spiBytes - bytes != frameLen)
+    {
+      if(bad++ < 5) printf("DEVID %02X %u Hz: sample %ld gives %ld %ld %02X, not %ld %ld %02X\n",
+                           devId, rate, i, (long)gotData, (long)gotResp, gotLoff,
+                           (long)(ch1[i] & mask), (long)(resp ? (ch2[i] & mask) : 0), loff);
+    }
+  }
+  sec = (double)(clock() - t0) / CLOCKS_PER_SEC;
+  
+  // no conversion after the stop
+  ADS1x9x_StopConvert();
+  if(AdsEmu_Drdy(0, 0, 0) || got != sigLen) bad++;
+  if(adsEmu.badBytes != 0) bad++;
+  
+  printf("DEVID %02X %u Hz: %ld samples of %u bytes, %.0f times real time, %ld errors\n",
+         devId, rate, got, frameLen, sec > 0 ? sigLen / (sec * rate) : 0.0, bad);
+  return (bad != 0);
+}
+
+// a chip not answering reads the same DEVID byte everywhere
+static int runStuck(uint8 devId)
+{
+  AdsEmu_Init(devId, TRUE);
+  ADS1x9x_Init(dataCB);
+  ADS1x9x_PowerUp();
+  
+#if defined(ECG_RESP)
+  if(ADS1x9x_HasResp())
+  {
+    printf("DEVID %02X: respiration read\n", devId);
+    return 1;
+  }
+#endif
+  if(ADS1x9x_Is24Bit())
+  {
+    printf("DEVID %02X: taken as 24 bits\n", devId);
+    return 1;
+  }
+  printf("DEVID %02X: not answering, taken as the ADS1191\n", devId);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  static const uint8 devIds[] = { 0x50, 0x51, 0x52, 0x53, 0x73 };
+  EcgSynth ecg;
+  int *trace;
+  long i;
+  int k, fail = 0;
+  
+  // the ECG and the respiration in 24 bits full scale, both signs and full scale reached
+  EcgSynth_Init(&ecg, 250, 72, 2000000, 5);
+  for(i = 0; i < SIGNAL_LEN; i++)
+  {
+    ch1[i] = EcgSynth_Next(&ecg);
+    ch2[i] = (int32)(i * 2311L % 0x1000000L) - 0x800000L;
+  }
+  
+  if(argc > 1)
+  {
+    sigLen = EcgTrace_Load(argv[1], &trace);
+    if(sigLen < 0)
+    {
+      printf("can not read %s\n", argv[1]);
+      return 1;
+    }
+    if(sigLen > SIGNAL_LEN) sigLen = SIGNAL_LEN;
+    for(i = 0; i < sigLen; i++) ch1[i] = trace[i];
+    free(trace);
+  }
+  
+  for(k = 0; k < (int)sizeof(devIds); k++)
+  {
+    fail |= runChip(devIds[k], HR_MODE_SAMPLERATE);
+    fail |= runChip(devIds[k], ECG_MODE_SAMPLERATE);
+  }
+  fail |= runStuck(0x00);
+  fail |= runStuck(0xFF);
+  
+  printf(fail ? "FAILED\n" : "passed\n");
+  return fail;
+}
@@ -0,0 +1,273 @@
+/*
+ * test_adsctrl.c : the ADS1x9x control of App_HRFunc.c on the OSAL simulator
+ *
+ * App_HRFunc.c runs as the HRM task on OsalSim.c, with the events of
+ * HRM_ProcessEvent() in CMTechHRMonitor.c, and drives Dev_ADS1x9x.c on the
+ * emulated ADS1x9x, which is fed with synthetic ECG at the sample rate set in
+ * its registers. The control steps of HRFunc_ProcessAdsCtrl() are checked from
+ * the chip side: the time to start converting, the stop, the power down held for
+ * ADS_POWERDOWN_TIME, the new registers after a sample rate change, the sampling
+ * suspended and probed while the leads are off, and requests that come while a
+ * step is waiting on its timer. The heart rate sent must follow the ECG.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "OSAL.h"
+#include "CMUtil.h"
+#include "App_HRFunc.h"
+#include "Dev_ADS1x9x.H"
+#include "Service_HRMonitor.h"
+#include "Service_Ecg.h"
+#include "CMTechHRMonitor.h"
+#include "OsalSim.h"
+#include "AdsEmu.h"
+#include "EcgSynth.h"
+
+#define TASK_ID         1
+#define HR_PERIOD       1000  // ms, the heart rate packets
+#define ECG_BPM         72
+#define ECG_AMP         (ECG_1MV_CALI_VALUE*256L) // counts per mV in 24 bits full scale
+
+uint16 SAMPLERATE = ECG_MODE_SAMPLERATE;
+
+static EcgSynth ecg;
+static uint8 loff;            // the LOFF_STAT fed with the samples
+
+// the chip seen at each tick
+static uint32 convStart;      // the tick the conversion started at, or (uint32)-1
+static uint32 rstLowAt;       // the tick PWDN/RESET went low
+static bool rstLow;
+static bool rstReleased;        // out of the reset at power on, the later resets are power downs
+static uint32 rstShort;       // the power downs shorter than ADS_POWERDOWN_TIME
+static uint32 drdys;          // the samples converted
+
+// the notifications sent
+static uint32 hrPacks, ecgPacks;
+static uint8 lastFlags, lastBpm;
+
+static int fail;
+
+bStatus_t HRM_MeasNotify(uint16 connHandle, attHandleValueNoti_t *pNoti)
+{
+  hrPacks++;
+  lastFlags = pNoti->value[0];
+  lastBpm = pNoti->value[1];
+  return SUCCESS;
+}
+
+bStatus_t ECG_PacketNotify(uint16 connHandle, attHandleValueNoti_t *pNoti)
+{
+  ecgPacks++;
+  return SUCCESS;
+}
+
+bStatus_t ECG_SetParameter(uint8 param, uint8 len, void *value) { return SUCCESS; }
+bStatus_t ECG_HrvNotify(uint16 connHandle) { return SUCCESS; }
+bStatus_t ECG_SqiNotify(uint16 connHandle) { return SUCCESS; }
+
+// the events of HRM_ProcessEvent() that App_HRFunc.c sets, one per call
+static uint16 processEvent(uint8 taskId, uint16 events)
+{
+  if(events & HRM_HR_PERIODIC_EVT)
+  {
+    HRFunc_SendHRPacket(0);
+    HRFunc_SendSqiPacket(0);
+    osal_start_timerEx(TASK_ID, HRM_HR_PERIODIC_EVT, HR_PERIOD);
+    return (events ^ HRM_HR_PERIODIC_EVT);
+  }
+  if(events & HRM_ECG_DATA_EVT)
+  {
+    HRFunc_ProcessEcgData();
+    return (events ^ HRM_ECG_DATA_EVT);
+  }
+  if(events & HRM_ADS_CTRL_EVT)
+  {
+    HRFunc_ProcessAdsCtrl();
+    return (events ^ HRM_ADS_CTRL_EVT);
+  }
+  if(events & HRM_LOFF_POLL_EVT)
+  {
+    HRFunc_ProcessLeadOffPoll();
+    return (events ^ HRM_LOFF_POLL_EVT);
+  }
+  if(events & HRM_ECG_NOTI_EVT)
+  {
+    HRFunc_SendEcgPacket(0);
+    return (events ^ HRM_ECG_NOTI_EVT);
+  }
+  return 0;
+}
+
+// the DRDY at the sample rate of the chip registers, and the pins watched
+static void tick(uint32 now)
+{
+  uint16 rate = AdsEmu_SampleRate();
+  bool conv = AdsEmu_Converting();
+  bool reset = AdsEmu_InReset();
+  
+  if(reset && !rstLow)
+  {
+    rstLow = TRUE;
+    rstLowAt = now;
+  }
+  else if(!reset && rstLow)
+  {
+    rstLow = FALSE;
+    if(rstReleased && now - rstLowAt < ADS_POWERDOWN_TIME) rstShort++;
+    rstReleased = TRUE;
+  }
+  
+  if(!conv)
+  {
+    convStart = (uint32)-1;
+    return;
+  }
+  if(convStart == (uint32)-1) convStart = now;
+  
+  if(ecg.sampleRate != rate) EcgSynth_Init(&ecg, rate, ECG_BPM, ECG_AMP, now);
+  if(now % (1000/rate) == 0)
+  {
+    AdsEmu_Drdy(EcgSynth_Next(&ecg), 0, loff);
+    drdys++;
+  }
+}
+
+static void check(bool ok, const char *what)
+{
+  printf("%6lu ms: %s%s\n", (unsigned long)OsalSim_Now(), ok ? "" : "FAILED: ", what);
+  if(!ok) fail = 1;
+}
+
+// run until the chip converts or not, at most ms.
+// return the tick it changed in, counted from the first one run, or -1
+static long runUntil(bool converting, uint32 ms)
+{
+  uint32 t0 = OsalSim_Now();
+  
+  while(OsalSim_Now() - t0 < ms)
+  {
+    OsalSim_Run(1);
+    if(AdsEmu_Converting() == converting) return (long)(OsalSim_Now() - 1 - t0);
+  }
+  return -1;
+}
+
+static bool bpmNear(int bpm)
+{
+  return lastBpm >= bpm - 4 && lastBpm <= bpm + 4;
+}
+
+int main(void)
+{
+  char msg[128];
+  long t;
+  uint32 n, resets, i;
+  clock_t c0 = clock();
+  
+  AdsEmu_Init(ADS1x9x_DEVID_ADS1291, FALSE);
+  OsalSim_Init(TASK_ID, processEvent, tick);
+  convStart = (uint32)-1;
+  
+  // HR mode as after a connection: powered, sampling, the heart rate calculated and sent
+  HRFunc_Init(TASK_ID);
+  HRFunc_SetHRCalcing(TRUE);
+  HRFunc_SetEcgSending(TRUE);
+  HRFunc_SetEcgPower(TRUE);
+  HRFunc_SetEcgSampling(TRUE);
+  osal_start_timerEx(TASK_ID, HRM_HR_PERIODIC_EVT, HR_PERIOD);
+  
+  // powered up, standby, woken up and started, each step waiting its time
+  t = runUntil(TRUE, 100);
+  sprintf(msg, "converting %ld ms after the start, %d expected", t, ADS_POWERUP_TIME + ADS_STANDBY_TIME + ADS_WAKEUP_TIME);
+  check(t == ADS_POWERUP_TIME + ADS_STANDBY_TIME + ADS_WAKEUP_TIME, msg);
+  check(AdsEmu_SampleRate() == ECG_MODE_SAMPLERATE, "registers set for 250 Hz");
+  
+  OsalSim_Run(20000);
+  sprintf(msg, "%lu samples in 20 s, %d bpm sent, %lu ecg packets", (unsigned long)drdys, lastBpm, (unsigned long)ecgPacks);
+  check(bpmNear(ECG_BPM) && (lastFlags & HRM_FLAGS_CONTACT_DET) == HRM_FLAGS_CONTACT_DET && ecgPacks > 0, msg);
+  
+  // stopped at once, kept in standby
+  HRFunc_SetEcgSampling(FALSE);
+  t = runUntil(FALSE, 10);
+  OsalSim_Run(100);
+  sprintf(msg, "stopped %ld ms after the request, kept in standby", t);
+  check(t >= 0 && t <= 1 && adsEmu.standby && !AdsEmu_InReset() && !AdsEmu_Converting(), msg);
+  
+  // started again from standby, without a power up
+  resets = adsEmu.resets;
+  HRFunc_SetEcgSampling(TRUE);
+  t = runUntil(TRUE, 100);
+  sprintf(msg, "converting %ld ms after the restart, %d expected", t, ADS_WAKEUP_TIME);
+  check(t == ADS_WAKEUP_TIME && adsEmu.resets == resets, msg);
+  
+  // HR mode while still settling: stopped when settled, powered down and up again
+  // with the registers for 125 Hz
+  SAMPLERATE = HR_MODE_SAMPLERATE;
+  HRFunc_SetSampleRate();
+  t = runUntil(FALSE, 100);
+  sprintf(msg, "stopped for the new sample rate %ld ms after the request, within the settling", t);
+  check(t >= 0 && t <= ADS_SETTLE_TIME, msg);
+  t = runUntil(TRUE, 100);
+  sprintf(msg, "converting at %u Hz %ld ms later, after a power down", AdsEmu_SampleRate(), t);
+  check(t >= ADS_STOP_TIME + ADS_POWERDOWN_TIME && AdsEmu_SampleRate() == HR_MODE_SAMPLERATE && adsEmu.resets == resets+1, msg);
+  OsalSim_Run(20000);
+  sprintf(msg, "%d bpm sent at 125 Hz", lastBpm);
+  check(bpmNear(ECG_BPM), msg);
+  
+  // the leads off: the contact is lost after LOFF_OFF_NUM samples and the sampling suspended
+  loff = ADS1x9x_LOFF_IN1P;
+  t = runUntil(FALSE, 2000);
+  OsalSim_Run(HR_PERIOD);
+  sprintf(msg, "suspended %ld ms after the leads off, contact %s", t,
+          (lastFlags & HRM_FLAGS_CONTACT_DET) == HRM_FLAGS_CONTACT_NOT_DET ? "not detected" : "detected");
+  check(t > 0 && (lastFlags & HRM_FLAGS_CONTACT_DET) == HRM_FLAGS_CONTACT_NOT_DET, msg);
+  
+  // probed every 4 s, a probe converts for a while and is suspended again
+  for(i = 0; i < 2; i++)
+  {
+    t = runUntil(TRUE, 5000);
+    n = drdys;
+    runUntil(FALSE, 2000);
+    sprintf(msg, "probe %lu after %ld ms, %lu samples", (unsigned long)i, t, (unsigned long)(drdys - n));
+    check(t > 0 && drdys - n > 0 && !AdsEmu_Converting(), msg);
+  }
+  
+  // the leads on: the next probe finds the contact and the sampling goes on
+  loff = 0;
+  t = runUntil(TRUE, 5000);
+  OsalSim_Run(15000);
+  sprintf(msg, "contact found by the probe after %ld ms, %d bpm sent", t, lastBpm);
+  check(t > 0 && AdsEmu_Converting() && (lastFlags & HRM_FLAGS_CONTACT_DET) == HRM_FLAGS_CONTACT_DET && bpmNear(ECG_BPM), msg);
+  
+  // requests while the steps wait on the timer: sampling toggled every ms, then left on
+  for(i = 0; i < 50; i++)
+  {
+    HRFunc_SetEcgSampling((i & 1) != 0);
+    OsalSim_Run(1);
+  }
+  HRFunc_SetEcgSampling(TRUE);
+  OsalSim_Run(100);
+  check(AdsEmu_Converting(), "converting after the requests toggled every ms");
+  
+  // powered off, and on again before the power down time is over
+  HRFunc_SetEcgSampling(FALSE);
+  HRFunc_SetEcgPower(FALSE);
+  OsalSim_Run(ADS_STOP_TIME + 1);
+  check(AdsEmu_InReset(), "powered down after the stop");
+  HRFunc_SetEcgPower(TRUE);
+  HRFunc_SetEcgSampling(TRUE);
+  t = runUntil(TRUE, 100);
+  sprintf(msg, "converting %ld ms after powered on again, %lu power downs shorter than %d ms",
+          t, (unsigned long)rstShort, ADS_POWERDOWN_TIME);
+  check(t > 0 && rstShort == 0, msg);
+  
+  sprintf(msg, "%lu SPI bytes out of CS or in reset, at most %u timers running, at most %u task calls per ms",
+          (unsigned long)adsEmu.badBytes, osalSimStat.maxTimers, osalSimStat.maxCalls);
+  check(adsEmu.badBytes == 0 && !osalSimStat.spinning, msg);
+  
+  printf("%.0f s of virtual time in %.2f s\n", OsalSim_Now() / 1000.0, (double)(clock() - c0) / CLOCKS_PER_SEC);
+  printf(fail ? "FAILED\n" : "passed\n");
+  return fail;
+}
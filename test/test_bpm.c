@@ -0,0 +1,32 @@
+/*
+ * test_bpm.c : Bpm_FromRR() against 60*rate/rr for every RR interval
+ */
+
+#include <stdio.h>
+#include "Bpm.h"
+
+static const uint16 rates[] = { 125, 250 };
+
+int main(void)
+{
+  long rr, bad = 0;
+  unsigned long ref;
+  int i;
+  
+  for(i = 0; i < (int)(sizeof(rates)/sizeof(rates[0])); i++)
+  {
+    for(rr = 1; rr <= 0xFFFF; rr++)
+    {
+      ref = (60UL*rates[i]) / (unsigned long)rr;
+      if(ref > BPM_MAX) ref = BPM_MAX;
+      if(Bpm_FromRR((uint16)rr, rates[i]) != ref)
+      {
+        if(bad++ < 5) printf("%u Hz: rr %ld gives %u, not %lu\n", rates[i], rr, Bpm_FromRR((uint16)rr, rates[i]), ref);
+      }
+    }
+    printf("%u Hz: RR intervals 1..65535 checked\n", rates[i]);
+  }
+  
+  printf(bad ? "FAILED\n" : "passed\n");
+  return (bad != 0);
+}
@@ -0,0 +1,73 @@
+/*
+ * test_divrecip.c : divRecip() of QRSFILT.CPP against the division
+ *
+ * For each filter divisor of the 125, 250 and 500 Hz tables, every dividend with
+ * |x| < 2^(16+shift) is divided both ways. The quotient estimate of the reciprocal
+ * must never be above the exact quotient and at most 2 below it.
+ */
+
+#include <stdio.h>
+
+// divRecip() is static, the filter source is built into the test
+#include "QRSFILT.CPP"
+
+static const QRSFiltParam params[] =
+{
+  QRS_FILT_PARAM(125),
+  QRS_FILT_PARAM(250),
+  QRS_FILT_PARAM(500)
+};
+static const int rates[] = { 125, 250, 500 };
+
+static int checkRecip(int rate, const char *name, const QRSRecip *r)
+{
+  long lim = 0x10000L << r->shift;
+  long x, bad = 0;
+  unsigned long u, est, exact;
+  unsigned long maxSteps = 0;
+  
+  if(r->m == 0 || (unsigned long)r->m * r->d > (0x10000UL << r->shift))
+  {
+    printf("%d Hz %s: reciprocal %u of %d out of range\n", rate, name, r->m, r->d);
+    return 1;
+  }
+  
+  for(x = -lim+1; x < lim; x++)
+  {
+    if(divRecip(x, r) != x / r->d)
+    {
+      if(bad++ < 5) printf("%d Hz %s: %ld/%d gives %ld\n", rate, name, x, r->d, divRecip(x, r));
+    }
+    
+    u = (x < 0) ? (unsigned long)(-x) : (unsigned long)x;
+    est = ((u >> r->shift) * r->m) >> 16;
+    exact = u / r->d;
+    if(est > exact)
+    {
+      if(bad++ < 5) printf("%d Hz %s: estimate of %ld/%d above the quotient\n", rate, name, x, r->d);
+    }
+    else if(exact - est > maxSteps)
+    {
+      maxSteps = exact - est;
+    }
+  }
+  
+  printf("%d Hz %s: d %d shift %d m %u, %ld dividends, %lu correction steps at most, %ld errors\n",
+         rate, name, r->d, r->shift, r->m, 2*lim-1, maxSteps, bad);
+  return (bad != 0 || maxSteps > 2);
+}
+
+int main(void)
+{
+  int i, fail = 0;
+  
+  for(i = 0; i < (int)(sizeof(rates)/sizeof(rates[0])); i++)
+  {
+    fail |= checkRecip(rates[i], "hpfilt", &params[i].hpDiv);
+    fail |= checkRecip(rates[i], "lpfilt", &params[i].lpDiv);
+    fail |= checkRecip(rates[i], "mvwint", &params[i].mvDiv);
+  }
+  
+  printf(fail ? "FAILED\n" : "passed\n");
+  return fail;
+}
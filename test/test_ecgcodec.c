@@ -0,0 +1,130 @@
+/*
+ * test_ecgcodec.c : round trip of the Rice coded ecg packets, and their compression
+ *
+ * A signal is coded into packets the way App_HRFunc.c does it, a packet is closed
+ * when the next sample does not fit and that sample opens the next packet.
+ * Every packet is decoded by EcgDecode.c on its own, and the decoded samples must
+ * be the signal. The signals are synthetic ECG at two gains, steps large enough to
+ * escape, full scale noise, a flat line filling packets of 255 samples, and a
+ * recorded trace if one is given. The bits per sample are reported against the
+ * 16 bits of the raw samples.
+ *
+ *   test_ecgcodec [trace]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "EcgCodec.h"
+#include "EcgDecode.h"
+#include "EcgSynth.h"
+
+#define SIGNAL_LEN      (60L*250)
+#define PACK_MAX_LEN    255
+
+static int16 x[SIGNAL_LEN];
+
+static int roundTrip(const char *name, const int16 *sig, long len, uint8 maxLen, long minEsc)
+{
+  static uint8 pack[PACK_MAX_LEN];
+  static int16 dec[256];
+  EcgRice_t rice;
+  uint8 packNum = 0, packLen;
+  long i = 0, j, pos = 0, packs = 0, bytes = 0, esc = 0, bad = 0;
+  int n, kMax = 0;
+  
+  EcgRice_Init(&rice, maxLen);
+  while(i < len)
+  {
+    EcgRice_Begin(&rice, pack, packNum, sig[i++]);
+    while(i < len && EcgRice_Add(&rice, sig[i])) i++;
+    packLen = EcgRice_End(&rice);
+    
+    n = EcgRice_Decode(pack, packLen, dec, &esc);
+    if(packLen > maxLen || n < 0 || pack[0] != packNum || pos + n > len)
+    {
+      printf("%s: packet %ld of %u bytes not valid\n", name, packs, packLen);
+      return 1;
+    }
+    for(j = 0; j < n; j++)
+    {
+      if(dec[j] != sig[pos+j] && bad++ < 5)
+        printf("%s: sample %ld decoded %d, not %d\n", name, pos+j, dec[j], sig[pos+j]);
+    }
+    if(pack[1] > kMax) kMax = pack[1];
+    
+    pos += n;
+    bytes += packLen;
+    packs++;
+    packNum++;
+  }
+  if(pos != len)
+  {
+    printf("%s: %ld samples decoded, not %ld\n", name, pos, len);
+    bad++;
+  }
+  if(esc < minEsc)
+  {
+    printf("%s: %ld samples escaped, at least %ld expected\n", name, esc, minEsc);
+    bad++;
+  }
+  
+  printf("%-12s %3u bytes: %5ld packets, %2.1f samples per packet, k up to %2d, %6ld escaped, "
+         "%5.2f bits per sample, %4.2f of raw, %ld errors\n",
+         name, maxLen, packs, (double)len/packs, kMax, esc, 8.0*bytes/len, 8.0*bytes/len/16, bad);
+  return (bad != 0);
+}
+
+int main(int argc, char *argv[])
+{
+  EcgSynth ecg;
+  unsigned long seed = 7;
+  long i, len;
+  int *trace;
+  int fail = 0;
+  
+  // the ECG at 5 uV per count, in the notifications of 20 bytes and the log records of 19
+  EcgSynth_Init(&ecg, 250, 72, 200, 1);
+  for(i = 0; i < SIGNAL_LEN; i++) x[i] = (int16)EcgSynth_Next(&ecg);
+  fail |= roundTrip("ecg", x, SIGNAL_LEN, 20, 0);
+  fail |= roundTrip("ecg", x, SIGNAL_LEN, 19, 0);
+  
+  // ten times the gain
+  EcgSynth_Init(&ecg, 250, 120, 2000, 2);
+  for(i = 0; i < SIGNAL_LEN; i++) x[i] = (int16)EcgSynth_Next(&ecg);
+  fail |= roundTrip("ecg x10", x, SIGNAL_LEN, 20, 0);
+  
+  // a full scale step every 50 samples escapes at any k, unless it opens a packet.
+  // a packet of 9 bytes is filled exactly by one escaped sample
+  for(i = 0; i < SIGNAL_LEN; i++) x[i] = (int16)((((i / 50) & 1) ? 30000 : -30000) + (i % 7));
+  fail |= roundTrip("steps", x, SIGNAL_LEN, 20, SIGNAL_LEN/50/3);
+  fail |= roundTrip("steps", x, SIGNAL_LEN, ECG_RICE_HEAD_LEN + 4, SIGNAL_LEN/50/3);
+  
+  // noise drives k to ECG_RICE_K_MAX, the largest differences still escape
+  for(i = 0; i < SIGNAL_LEN; i++)
+  {
+    seed = seed * 1103515245UL + 12345UL;
+    x[i] = (int16)(((seed >> 8) & 0xFFFF) - 32768);
+  }
+  fail |= roundTrip("noise", x, SIGNAL_LEN, 20, 1);
+  
+  // one bit per sample, the packets are closed at 255 samples, not at their length
+  for(i = 0; i < SIGNAL_LEN; i++) x[i] = -1234;
+  fail |= roundTrip("flat", x, SIGNAL_LEN, PACK_MAX_LEN, 0);
+  
+  if(argc > 1)
+  {
+    len = EcgTrace_Load(argv[1], &trace);
+    if(len < 0)
+    {
+      printf("can not read %s\n", argv[1]);
+      return 1;
+    }
+    if(len > SIGNAL_LEN) len = SIGNAL_LEN;
+    for(i = 0; i < len; i++) x[i] = (int16)trace[i];
+    free(trace);
+    fail |= roundTrip(argv[1], x, len, 20, 0);
+  }
+  
+  printf(fail ? "FAILED\n" : "passed\n");
+  return fail;
+}
@@ -0,0 +1,122 @@
+/*
+ * test_qrsfilt.c : the fused QRS filters against the separate stages
+ *
+ * QRSFilter() and deriv1() run side by side with QrsFiltRef.c at 125, 250 and
+ * 500 Hz on synthetic ECG, on ECG large enough to saturate the high-pass filter,
+ * on full scale noise and on a full scale square wave. Both outputs must be the
+ * same sample for sample, and so must the saturation counts.
+ *
+ *   test_qrsfilt [trace rate]   also runs the recorded trace sampled at rate
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "QRSFILT.H"
+#include "QrsFiltRef.h"
+#include "EcgSynth.h"
+
+#define SIGNAL_LEN    (60L*500)
+
+static const QRSFiltParam params[] =
+{
+  QRS_FILT_PARAM(125),
+  QRS_FILT_PARAM(250),
+  QRS_FILT_PARAM(500)
+};
+static const int rates[] = { 125, 250, 500 };
+#define RATE_NUM  ((int)(sizeof(rates)/sizeof(rates[0])))
+
+static QRSFiltState filt;
+static QRSRefState ref;
+
+static int compare(const char *name, int rate, const QRSFiltParam *p, const int *x, long len)
+{
+  long i, bad = 0;
+  int f, r, d1, d2;
+  
+  filt.p = p;
+  ref.p = p;
+  QRSFilter(&filt, 0, 1);
+  deriv1(&filt, 0, 1);
+  QRSRefFilter(&ref, 0, 1);
+  QRSRefDeriv1(&ref, 0, 1);
+  
+  for(i = 0; i < len; i++)
+  {
+    f = QRSFilter(&filt, x[i], 0);
+    d1 = deriv1(&filt, x[i], 0);
+    r = QRSRefFilter(&ref, x[i], 0);
+    d2 = QRSRefDeriv1(&ref, x[i], 0);
+    if(f != r || d1 != d2)
+    {
+      if(bad++ < 5) printf("%s %d Hz sample %ld: QRSFilter %d/%d deriv1 %d/%d\n", name, rate, i, f, r, d1, d2);
+    }
+  }
+  if(filt.hpClip != ref.hpClip)
+  {
+    printf("%s %d Hz: %u saturated samples, %u expected\n", name, rate, filt.hpClip, ref.hpClip);
+    bad++;
+  }
+  
+  printf("%s %d Hz: %ld samples, %u saturated, %ld mismatches\n", name, rate, len, ref.hpClip, bad);
+  return (bad != 0);
+}
+
+static int runSignals(int k, int *x)
+{
+  int rate = rates[k];
+  long len = SIGNAL_LEN * rate / 500, i;
+  unsigned long seed = 1;
+  EcgSynth ecg;
+  int fail = 0;
+  
+  // the ECG at the detector scale of 5 uV per count
+  EcgSynth_Init(&ecg, rate, 72, 200, 1);
+  for(i = 0; i < len; i++) x[i] = EcgSynth_Next(&ecg);
+  fail |= compare("ecg", rate, &params[k], x, len);
+  
+  // 40 uV per count saturates the high-pass filter on every R peak
+  EcgSynth_Init(&ecg, rate, 150, 25000, 2);
+  for(i = 0; i < len; i++) x[i] = EcgSynth_Next(&ecg);
+  fail |= compare("ecg x125", rate, &params[k], x, len);
+  
+  for(i = 0; i < len; i++)
+  {
+    seed = seed * 1103515245UL + 12345UL;
+    x[i] = (int)((seed >> 8) & 0xFFFF) - 32768;
+  }
+  fail |= compare("noise", rate, &params[k], x, len);
+  
+  for(i = 0; i < len; i++) x[i] = ((i / (rate/2)) & 1) ? 32767 : -32768;
+  fail |= compare("square", rate, &params[k], x, len);
+  
+  return fail;
+}
+
+int main(int argc, char *argv[])
+{
+  static int x[SIGNAL_LEN];
+  int *trace;
+  long len;
+  int k, rate, fail = 0;
+  
+  for(k = 0; k < RATE_NUM; k++)
+    fail |= runSignals(k, x);
+  
+  if(argc > 2)
+  {
+    rate = atoi(argv[2]);
+    for(k = 0; k < RATE_NUM && rates[k] != rate; k++);
+    len = EcgTrace_Load(argv[1], &trace);
+    if(k == RATE_NUM || len < 0)
+    {
+      printf("can not run %s at %s Hz\n", argv[1], argv[2]);
+      return 1;
+    }
+    fail |= compare(argv[1], rate, &params[k], trace, len);
+    free(trace);
+  }
+  
+  printf(fail ? "FAILED\n" : "passed\n");
+  return fail;
+}